@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm> // For min, fill
+#include <cstdint>   // For fixed-width header fields
+#include <cstdio>    // For FILE-based export
+#include <cstdlib>   // For aligned allocation
+#ifdef _WIN32
+#include <malloc.h>  // For _aligned_malloc
+#endif
+#include <cstring>   // For memcpy
+#include <limits>    // For infinity
+#include <new>       // For bad_alloc
+#include <string>    // For paths
+#include "parallel.h"   // For parallelFor
+#include "road_graph.h" // Direct budgets come from the road graph
+#include "snapshot.h"   // For snapshotChecksum
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h> // For the SIMD min-plus kernels
+#endif
+
+// All-pairs cheapest budgets (transitive costs between every two cities).
+//
+// The table is one flat, 64-byte aligned buffer whose row stride is padded
+// to a whole number of kBlock x kBlock tiles. Floyd-Warshall runs tile by
+// tile: for each diagonal tile k, first tile (k, k), then the tiles of row
+// and column k, then all the others. Tiles within the second and third
+// phases are independent and are spread across worker threads, and each
+// tile update is a min-plus kernel whose inner loop runs over contiguous
+// doubles (AVX when the compiler targets it, SSE2 otherwise on x86).
+class AllPairsBudgets {
+public:
+    static constexpr size_t kBlock = 64; // 64 x 64 doubles = 32 KB per tile
+
+    AllPairsBudgets() = default;
+    AllPairsBudgets(const AllPairsBudgets&) = delete;
+    AllPairsBudgets& operator=(const AllPairsBudgets&) = delete;
+    ~AllPairsBudgets() { release(); }
+
+    // Bytes the table needs for n cities (to check before computing)
+    static size_t bytesFor(uint32_t n) {
+        size_t stride = (size_t(n) + kBlock - 1) / kBlock * kBlock;
+        return stride * stride * sizeof(double);
+    }
+
+    // Fill the table from the graph and run blocked Floyd-Warshall.
+    // Throws std::bad_alloc if the table does not fit in memory.
+    void compute(const RoadGraph& graph) {
+        allocate(graph.cityCount());
+        const double inf = std::numeric_limits<double>::infinity();
+        std::fill(data_, data_ + stride_ * stride_, inf);
+        for (size_t i = 0; i < stride_; ++i) at(i, i) = 0.0; // Padding cities reach only themselves
+        graph.forEachRoad([&](uint32_t a, uint32_t b, double budget) {
+            at(a, b) = std::min(at(a, b), budget);
+            at(b, a) = at(a, b);
+        });
+
+        const size_t tiles = stride_ / kBlock;
+        for (size_t k = 0; k < tiles; ++k) {
+            minPlus(k, k, k);
+            // Row and column k: 2 * (tiles - 1) independent tiles
+            parallelFor(2 * tiles, [&](size_t begin, size_t end, unsigned) {
+                for (size_t t = begin; t < end; ++t) {
+                    size_t other = t / 2;
+                    if (other == k) continue;
+                    if (t % 2 == 0) minPlus(k, other, k); // Tile (k, other)
+                    else minPlus(other, k, k);            // Tile (other, k)
+                }
+            }, 1);
+            // Everything else
+            parallelFor(tiles * tiles, [&](size_t begin, size_t end, unsigned) {
+                for (size_t t = begin; t < end; ++t) {
+                    size_t bi = t / tiles, bj = t % tiles;
+                    if (bi != k && bj != k) minPlus(bi, bj, k);
+                }
+            }, 1);
+        }
+    }
+
+    uint32_t cityCount() const { return n_; }
+
+    // Cheapest total budget from a to b; infinity if no route exists
+    double budget(uint32_t a, uint32_t b) const { return data_[a * stride_ + b]; }
+
+    // Write the table as: magic "RBPAPSP\0", u32 version, u32 city count,
+    // u64 checksum of the payload, then count * count doubles row by row
+    bool exportBinary(const std::string& path) const {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        uint64_t checksum = 0; // Chained over the unpadded rows
+        for (size_t i = 0; i < n_; ++i) {
+            const char* row = reinterpret_cast<const char*>(data_ + i * stride_);
+            checksum = checksum * 0x100000001B3ull ^ snapshotChecksum(row, n_ * sizeof(double));
+        }
+        const char magic[8] = {'R', 'B', 'P', 'A', 'P', 'S', 'P', '\0'};
+        uint32_t version = 1;
+        bool ok = fwrite(magic, 1, 8, f) == 8 && fwrite(&version, 4, 1, f) == 1 &&
+                  fwrite(&n_, 4, 1, f) == 1 && fwrite(&checksum, 8, 1, f) == 1;
+        for (size_t i = 0; ok && i < n_; ++i) {
+            ok = fwrite(data_ + i * stride_, sizeof(double), n_, f) == n_;
+        }
+        return fclose(f) == 0 && ok;
+    }
+
+private:
+    void allocate(uint32_t n) {
+        release();
+        n_ = n;
+        stride_ = (size_t(n) + kBlock - 1) / kBlock * kBlock;
+        size_t bytes = std::max<size_t>(stride_ * stride_ * sizeof(double), 64); // A multiple of 64
+#ifdef _WIN32
+        data_ = static_cast<double*>(_aligned_malloc(bytes, 64));
+#else
+        data_ = static_cast<double*>(std::aligned_alloc(64, bytes));
+#endif
+        if (!data_) throw std::bad_alloc();
+    }
+
+    void release() {
+#ifdef _WIN32
+        _aligned_free(data_);
+#else
+        std::free(data_);
+#endif
+        data_ = nullptr;
+    }
+
+    double& at(size_t i, size_t j) { return data_[i * stride_ + j]; }
+
+    // Tile (bi, bj) = min(tile (bi, bj), tile (bi, bk) (+) tile (bk, bj)).
+    // k is the outer loop, so this is also correct when tiles alias (the
+    // diagonal tile and the tiles of row/column bk).
+    void minPlus(size_t bi, size_t bj, size_t bk) {
+        double* c = data_ + bi * kBlock * stride_ + bj * kBlock;
+        const double* a = data_ + bi * kBlock * stride_ + bk * kBlock;
+        const double* b = data_ + bk * kBlock * stride_ + bj * kBlock;
+        for (size_t k = 0; k < kBlock; ++k) {
+            const double* bRow = b + k * stride_;
+            for (size_t i = 0; i < kBlock; ++i) {
+                double aik = a[i * stride_ + k];
+                double* cRow = c + i * stride_;
+#if defined(__AVX__)
+                __m256d av = _mm256_set1_pd(aik);
+                for (size_t j = 0; j < kBlock; j += 4) {
+                    __m256d sum = _mm256_add_pd(av, _mm256_load_pd(bRow + j));
+                    _mm256_store_pd(cRow + j, _mm256_min_pd(_mm256_load_pd(cRow + j), sum));
+                }
+#elif defined(__SSE2__)
+                __m128d av = _mm_set1_pd(aik);
+                for (size_t j = 0; j < kBlock; j += 2) {
+                    __m128d sum = _mm_add_pd(av, _mm_load_pd(bRow + j));
+                    _mm_store_pd(cRow + j, _mm_min_pd(_mm_load_pd(cRow + j), sum));
+                }
+#else
+                for (size_t j = 0; j < kBlock; ++j) {
+                    double sum = aik + bRow[j];
+                    cRow[j] = cRow[j] < sum ? cRow[j] : sum;
+                }
+#endif
+            }
+        }
+    }
+
+    double* data_ = nullptr;
+    uint32_t n_ = 0;
+    size_t stride_ = 0; // Padded row length, a multiple of kBlock
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm> // For min, max, partial_sort
+#include <cmath>     // For ldexp (histogram bin edges)
+#include <cstdint>   // For fixed-width counts
+#include <cstring>   // For memcpy
+#include <limits>    // For infinity
+#include <vector>    // For per-worker partials and per-city results
+#include "parallel.h"   // For parallelFor
+#include "road_graph.h" // Statistics are taken over the CSR budget array
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h> // For the SIMD reductions
+#endif
+
+// Budget analytics: totals, min/max/mean, a histogram and per-city rollups.
+//
+// Everything is read straight from the CSR weight array, which holds every
+// road's budget twice (once per direction), in one streaming pass split
+// across worker threads. Each worker reduces its chunk with SIMD min/max/sum
+// and bumps a power-of-two histogram keyed by the budget's exponent bits, so
+// no bin edges have to be known up front. Sums and counts are halved once at
+// the end. Min and mean cover budgeted roads only: a road still at 0 would
+// otherwise pin the minimum to 0 and drag the mean down. The graph must be
+// compacted first (pending roads are not read).
+
+struct BudgetHistogramBin {
+    double lower;   // Inclusive; 0 for the "no budget" bin
+    double upper;   // Exclusive; 0 for the "no budget" bin
+    uint64_t roads;
+};
+
+struct BudgetStats {
+    uint64_t roads = 0;
+    uint64_t unbudgeted = 0; // Roads whose budget is still 0
+    double total = 0.0;
+    double min = 0.0;  // Over budgeted roads; 0 if there are none
+    double max = 0.0;
+    double mean = 0.0; // Over budgeted roads; 0 if there are none
+    std::vector<BudgetHistogramBin> histogram; // Ascending, from the lowest to the highest non-empty bin
+};
+
+struct CityRollup {
+    std::vector<uint32_t> degree; // Roads touching each city
+    std::vector<double> budget;   // Sum of the budgets of those roads
+    uint32_t maxDegree = 0;
+    uint32_t isolated = 0;        // Cities without roads
+};
+
+namespace analytics_detail {
+
+constexpr size_t kExponents = 2048; // Every 11-bit IEEE exponent
+
+struct Partial {
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity(); // Of the non-zero budgets
+    double max = -std::numeric_limits<double>::infinity();
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(kExponents, 0);
+};
+
+// Budgets are non-negative, so the top bits are just the exponent
+inline size_t exponentOf(double d) {
+    uint64_t u;
+    std::memcpy(&u, &d, sizeof u);
+    return size_t(u >> 52) & (kExponents - 1);
+}
+
+inline void reduce(const double* v, size_t n, Partial& p) {
+    uint64_t* buckets = p.buckets.data();
+    size_t i = 0;
+#if defined(__AVX__)
+    __m256d sum = _mm256_setzero_pd();
+    __m256d lo = _mm256_set1_pd(p.min), hi = _mm256_set1_pd(p.max);
+    const __m256d zero = _mm256_setzero_pd(), inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(v + i);
+        sum = _mm256_add_pd(sum, x);
+        lo = _mm256_min_pd(lo, _mm256_blendv_pd(x, inf, _mm256_cmp_pd(x, zero, _CMP_EQ_OQ))); // Zeros are not budgets
+        hi = _mm256_max_pd(hi, x);
+        ++buckets[exponentOf(v[i])];
+        ++buckets[exponentOf(v[i + 1])];
+        ++buckets[exponentOf(v[i + 2])];
+        ++buckets[exponentOf(v[i + 3])];
+    }
+    alignas(32) double s[4], l[4], h[4];
+    _mm256_store_pd(s, sum);
+    _mm256_store_pd(l, lo);
+    _mm256_store_pd(h, hi);
+    p.sum += (s[0] + s[1]) + (s[2] + s[3]);
+    p.min = std::min(std::min(l[0], l[1]), std::min(l[2], l[3]));
+    p.max = std::max(std::max(h[0], h[1]), std::max(h[2], h[3]));
+#elif defined(__SSE2__)
+    __m128d sum = _mm_setzero_pd();
+    __m128d lo = _mm_set1_pd(p.min), hi = _mm_set1_pd(p.max);
+    const __m128d zero = _mm_setzero_pd(), inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(v + i);
+        sum = _mm_add_pd(sum, x);
+        __m128d unset = _mm_cmpeq_pd(x, zero); // Zeros are not budgets
+        lo = _mm_min_pd(lo, _mm_or_pd(_mm_and_pd(unset, inf), _mm_andnot_pd(unset, x)));
+        hi = _mm_max_pd(hi, x);
+        ++buckets[exponentOf(v[i])];
+        ++buckets[exponentOf(v[i + 1])];
+    }
+    alignas(16) double s[2], l[2], h[2];
+    _mm_store_pd(s, sum);
+    _mm_store_pd(l, lo);
+    _mm_store_pd(h, hi);
+    p.sum += s[0] + s[1];
+    p.min = std::min(l[0], l[1]);
+    p.max = std::max(h[0], h[1]);
+#endif
+    for (; i < n; ++i) {
+        p.sum += v[i];
+        if (v[i] != 0.0) p.min = std::min(p.min, v[i]);
+        p.max = std::max(p.max, v[i]);
+        ++buckets[exponentOf(v[i])];
+    }
+}
+
+} // namespace analytics_detail
+
+inline BudgetStats budgetStats(const RoadGraph& graph) {
+    using namespace analytics_detail;
+    const std::vector<double>& w = graph.weight;
+    std::vector<Partial> partials(workerCount());
+    parallelFor(w.size(), [&](size_t begin, size_t end, unsigned worker) {
+        reduce(w.data() + begin, end - begin, partials[worker]);
+    }, 1 << 16);
+
+    BudgetStats stats;
+    if (w.empty()) return stats;
+    Partial all;
+    for (const Partial& p : partials) {
+        all.sum += p.sum;
+        all.min = std::min(all.min, p.min);
+        all.max = std::max(all.max, p.max);
+        for (size_t e = 0; e < kExponents; ++e) all.buckets[e] += p.buckets[e];
+    }
+    stats.roads = w.size() / 2; // Each road is stored in both directions
+    stats.total = all.sum / 2;
+    stats.max = all.max;
+    stats.unbudgeted = all.buckets[0] / 2; // Exponent 0: zero (or a denormal)
+    if (stats.unbudgeted < stats.roads) {
+        stats.min = all.min;
+        stats.mean = stats.total / double(stats.roads - stats.unbudgeted);
+    }
+
+    size_t first = 1, last = kExponents - 1;
+    while (first < kExponents && all.buckets[first] == 0) ++first;
+    while (last > 0 && all.buckets[last] == 0) --last;
+    if (stats.unbudgeted) stats.histogram.push_back({0.0, 0.0, stats.unbudgeted});
+    for (size_t e = first; e <= last && e < kExponents; ++e) {
+        double lower = std::ldexp(1.0, int(e) - 1023);
+        stats.histogram.push_back({lower, lower * 2, all.buckets[e] / 2});
+    }
+    return stats;
+}
+
+// Degree and total budget per city: one CSR row per city, rows split across workers
+inline CityRollup cityRollup(const RoadGraph& graph) {
+    const uint32_t n = graph.cityCount();
+    CityRollup rollup;
+    rollup.degree.resize(n);
+    rollup.budget.resize(n);
+    parallelFor(n, [&](size_t begin, size_t end, unsigned) {
+        for (size_t u = begin; u < end; ++u) {
+            uint32_t s = graph.rowBegin(uint32_t(u)), e = graph.rowEnd(uint32_t(u));
+            double sum = 0.0;
+            for (uint32_t k = s; k < e; ++k) sum += graph.weight[k];
+            rollup.degree[u] = e - s;
+            rollup.budget[u] = sum;
+        }
+    });
+    for (uint32_t d : rollup.degree) {
+        rollup.maxDegree = std::max(rollup.maxDegree, d);
+        rollup.isolated += d == 0;
+    }
+    return rollup;
+}
+
+// Indices of the k largest values, largest first (ties by lower index)
+template <class T>
+std::vector<uint32_t> topIndices(const std::vector<T>& values, size_t k) {
+    std::vector<uint32_t> order(values.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    k = std::min(k, order.size());
+    std::partial_sort(order.begin(), order.begin() + k, order.end(), [&](uint32_t a, uint32_t b) {
+        return values[a] != values[b] ? values[a] > values[b] : a < b;
+    });
+    order.resize(k);
+    return order;
+}
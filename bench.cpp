@@ -0,0 +1,387 @@
+// Scaling benchmark for the core network operations.
+//
+// Builds synthetic networks (random geometric, grid, scale-free) at growing
+// city counts and times the operations behind the menu: adding cities, name
+// lookups, adding roads and budgets, saving and loading, routing and
+// rendering. Operations timed one call at a time report latency
+// percentiles; whole-network operations (bulk load, save, load) report
+// throughput only. Results go out as CSV or JSON.
+//
+//     g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+//     bench [--sizes 100,1000,...] [--generators geometric,grid,scalefree]
+//           [--format csv|json] [--out file]
+
+#include <algorithm> // For sort, nth_element, min
+#include <chrono>    // For timing
+#include <cmath>     // For sqrt
+#include <cstdio>    // For remove
+#include <fstream>   // For the roads.txt-style save and the results file
+#include <iomanip>   // For fixed, setprecision
+#include <iostream>  // For results and errors
+#include <random>    // For the generators and query mixes
+#include <sstream>   // For splitting option lists
+#include <string>    // For names and options
+#include <vector>    // For edge lists and latency samples
+#include <fcntl.h>   // For opening the null device
+#ifndef _WIN32
+#include <unistd.h>  // For close
+#endif
+#include "city_table.h"
+#include "mapped_file.h"
+#include "render.h"
+#include "road_graph.h"
+#include "routing.h"
+#include "snapshot.h"
+#include "text_format.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// --- Synthetic networks ---
+
+struct Network {
+    uint32_t cities = 0;
+    vector<RoadGraph::Road> roads; // No self-loops, no duplicates
+};
+
+double randomBudget(mt19937_64& rng) {
+    return double(rng() % 10000 + 1) / 100; // 0.01 .. 100.00
+}
+
+// n points in the unit square, linked when closer than a radius chosen for
+// about 6 roads per city. Budgets grow with distance.
+Network randomGeometric(uint32_t n, mt19937_64& rng) {
+    Network net;
+    net.cities = n;
+    uniform_real_distribution<double> coord(0.0, 1.0);
+    vector<double> x(n), y(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        x[i] = coord(rng);
+        y[i] = coord(rng);
+    }
+    double radius = sqrt(6.0 / (3.14159265358979 * n));
+    uint32_t side = max<uint32_t>(1, uint32_t(1.0 / radius));
+    vector<vector<uint32_t>> cells(size_t(side) * side); // Bucket grid, one radius per cell
+    auto cellOf = [&](double v) { return min(side - 1, uint32_t(v * side)); };
+    for (uint32_t i = 0; i < n; ++i) cells[size_t(cellOf(y[i])) * side + cellOf(x[i])].push_back(i);
+    for (uint32_t i = 0; i < n; ++i) {
+        int cx = int(cellOf(x[i])), cy = int(cellOf(y[i]));
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                int nx = cx + dx, ny = cy + dy;
+                if (nx < 0 || ny < 0 || nx >= int(side) || ny >= int(side)) continue;
+                for (uint32_t j : cells[size_t(ny) * side + nx]) {
+                    if (j <= i) continue;
+                    double d = hypot(x[i] - x[j], y[i] - y[j]);
+                    if (d < radius) net.roads.push_back({i, j, 0.01 + round(d * 100000) / 100});
+                }
+            }
+        }
+    }
+    return net;
+}
+
+// Square lattice (the last row may be partial), each city linked to its
+// right and lower neighbours
+Network grid(uint32_t n, mt19937_64& rng) {
+    Network net;
+    net.cities = n;
+    uint32_t side = max<uint32_t>(1, uint32_t(ceil(sqrt(double(n)))));
+    for (uint32_t i = 0; i < n; ++i) {
+        if ((i + 1) % side != 0 && i + 1 < n) net.roads.push_back({i, i + 1, randomBudget(rng)});
+        if (i + side < n) net.roads.push_back({i, i + side, randomBudget(rng)});
+    }
+    return net;
+}
+
+// Barabasi-Albert preferential attachment: each new city links to 3
+// distinct existing cities picked in proportion to their road count
+Network scaleFree(uint32_t n, mt19937_64& rng) {
+    const uint32_t m = 3;
+    Network net;
+    net.cities = n;
+    vector<uint32_t> endpoints; // Every road end so far: picking one is degree-proportional
+    for (uint32_t i = 0; i < min(n, m + 1); ++i) {
+        for (uint32_t j = 0; j < i; ++j) {
+            net.roads.push_back({j, i, randomBudget(rng)});
+            endpoints.push_back(i);
+            endpoints.push_back(j);
+        }
+    }
+    for (uint32_t i = m + 1; i < n; ++i) {
+        uint32_t picked[m];
+        uint32_t count = 0;
+        while (count < m) {
+            uint32_t t = endpoints[rng() % endpoints.size()];
+            if (find(picked, picked + count, t) == picked + count) picked[count++] = t;
+        }
+        for (uint32_t t : picked) {
+            net.roads.push_back({t, i, randomBudget(rng)});
+            endpoints.push_back(i);
+            endpoints.push_back(t);
+        }
+    }
+    return net;
+}
+
+// --- Measurement ---
+
+struct Result {
+    string generator;
+    uint32_t cities;
+    size_t roads;
+    string operation;
+    size_t ops = 0;
+    double seconds = 0.0;
+    vector<uint32_t> latencies; // Nanoseconds per call, when timed per call
+
+    Result(string generator, uint32_t cities, size_t roads, string operation)
+        : generator(move(generator)), cities(cities), roads(roads), operation(move(operation)) {}
+};
+
+double percentile(vector<uint32_t>& samples, double p) {
+    if (samples.empty()) return 0.0;
+    size_t k = min(samples.size() - 1, size_t(p * double(samples.size())));
+    nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+// Run op(i) for i in [0, count), timing every call
+template <class Op>
+void timeEach(Result& r, size_t count, Op op) {
+    r.latencies.resize(count);
+    auto start = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        auto t0 = Clock::now();
+        op(i);
+        r.latencies[i] = uint32_t(min<int64_t>(UINT32_MAX, chrono::duration_cast<chrono::nanoseconds>(Clock::now() - t0).count()));
+    }
+    r.seconds = chrono::duration<double>(Clock::now() - start).count();
+    r.ops = count;
+}
+
+// Run op() once over ops items
+template <class Op>
+void timeOnce(Result& r, size_t ops, Op op) {
+    auto start = Clock::now();
+    op();
+    r.seconds = chrono::duration<double>(Clock::now() - start).count();
+    r.ops = ops;
+}
+
+string cityName(uint32_t i) {
+    return "City" + to_string(i);
+}
+
+int openNullDevice() {
+#ifdef _WIN32
+    return _open("NUL", _O_WRONLY);
+#else
+    return open("/dev/null", O_WRONLY);
+#endif
+}
+
+void closeFd(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+void runSuite(const string& generator, const Network& net, vector<Result>& results, mt19937_64& rng) {
+    const uint32_t n = net.cities;
+    const size_t m = net.roads.size();
+    auto result = [&](const string& operation) -> Result& {
+        results.emplace_back(generator, n, m, operation);
+        return results.back();
+    };
+    vector<string> names(n);
+    for (uint32_t i = 0; i < n; ++i) names[i] = cityName(i);
+
+    // Menu 1: add cities one at a time (name index + graph growth)
+    CityTable cities;
+    RoadGraph graph;
+    timeEach(result("add_city"), n, [&](size_t i) {
+        cities.add(names[i]);
+        graph.resize(cities.size());
+    });
+
+    // getCityIndex(): random hits, then misses
+    size_t lookups = max<size_t>(n, 100000);
+    vector<uint32_t> probe(lookups);
+    for (uint32_t& p : probe) p = uint32_t(rng() % n);
+    volatile int sink = 0;
+    timeEach(result("find_city_hit"), lookups, [&](size_t i) { sink = cities.find(names[probe[i]]); });
+    string missing = "Nowhere";
+    timeEach(result("find_city_miss"), lookups / 10, [&](size_t) { sink = cities.find(missing); });
+
+    // Menu 2 and 3: roads and budgets one at a time
+    timeEach(result("add_road"), m, [&](size_t i) { graph.addRoad(net.roads[i].from, net.roads[i].to); });
+    timeEach(result("set_budget"), m, [&](size_t i) {
+        graph.setBudget(net.roads[i].from, net.roads[i].to, net.roads[i].budget);
+    });
+
+    // Loading a whole file: one sort and merge
+    RoadGraph bulk;
+    bulk.resize(n);
+    vector<RoadGraph::Road> copy = net.roads;
+    timeOnce(result("bulk_load_roads"), m, [&] { bulk.addRoadsBulk(move(copy)); });
+
+    // Cheapest-route queries between random cities (fewer on large networks,
+    // where one query can explore most of the graph)
+    graph.compact();
+    RoutePlanner planner;
+    size_t queries = min<size_t>(1000, max<size_t>(20, 20000000 / n));
+    timeEach(result("route_bidirectional"), queries, [&](size_t) {
+        planner.bidirectional(graph, uint32_t(rng() % n), uint32_t(rng() % n));
+    });
+
+    // saveRoadsToFile(): the roads.txt layout through iostreams
+    const string textPath = "bench_roads.txt.tmp", snapPath = "bench_network.bin.tmp";
+    auto nameOf = [&](uint32_t i) { return cities[i]; };
+    timeOnce(result("save_roads_text"), m, [&] {
+        ofstream out(textPath);
+        writeRoadsText(out, graph, nameOf);
+    });
+    timeOnce(result("load_roads_text"), m, [&] {
+        MappedFile file;
+        file.open(textPath);
+        RoadGraph loaded;
+        loaded.resize(n);
+        vector<RoadGraph::Road> roads;
+        auto lookup = [&](string_view name) { return cities.find(name); };
+        parseRoadsText(file.begin(), file.end(), lookup, [&](int a, int b, double budget) {
+            roads.push_back({uint32_t(a), uint32_t(b), budget});
+        });
+        loaded.addRoadsBulk(move(roads));
+    });
+
+    // network.bin
+    timeOnce(result("snapshot_write"), m, [&] {
+        writeSnapshot(snapPath, n, [&](uint32_t i) { return cities[i]; }, graph);
+    });
+    timeOnce(result("snapshot_open"), m, [&] {
+        SnapshotView view;
+        string error;
+        view.open(snapPath, error);
+        double total = 0.0; // Touch every road
+        for (size_t i = 0; i < view.roadCount(); ++i) total += view.roads()[i].budget;
+        sink = int(total);
+    });
+    remove(textPath.c_str());
+    remove(snapPath.c_str());
+
+    // Menus 7 and 8: the menu's own renderers, sent to the null device
+    int devNull = openNullDevice();
+    auto unpaged = [] { return true; };
+    timeOnce(result("display_road_list"), m, [&] {
+        OutputBuffer out(1 << 20, devNull);
+        renderRoadLines(out, graph, nameOf, unpaged);
+    });
+    if (n <= 5000) { // The full matrix is O(N^2) cells
+        timeOnce(result("display_budget_matrix"), size_t(n) * n, [&] {
+            OutputBuffer out(1 << 20, devNull);
+            MatrixWindow all{0, n, 0, n};
+            renderBudgetMatrix(out, graph, all, [](uint32_t) { return true; }, nameOf, unpaged);
+        });
+    }
+    closeFd(devNull);
+}
+
+// --- Output ---
+
+void writeCsv(ostream& out, vector<Result>& results) {
+    out << "generator,cities,roads,operation,ops,seconds,ops_per_sec,p50_ns,p90_ns,p99_ns,max_ns\n";
+    for (Result& r : results) {
+        out << r.generator << ',' << r.cities << ',' << r.roads << ',' << r.operation << ',' << r.ops << ','
+            << fixed << setprecision(6) << r.seconds << ',' << setprecision(1) << (r.seconds > 0 ? r.ops / r.seconds : 0.0);
+        if (r.latencies.empty()) { // Throughput only: no percentiles
+            out << ",,,,\n";
+            continue;
+        }
+        out << ',' << setprecision(0) << percentile(r.latencies, 0.50) << ',' << percentile(r.latencies, 0.90) << ','
+            << percentile(r.latencies, 0.99) << ',' << percentile(r.latencies, 1.0) << '\n';
+    }
+}
+
+void writeJson(ostream& out, vector<Result>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        Result& r = results[i];
+        out << "  {\"generator\": \"" << r.generator << "\", \"cities\": " << r.cities << ", \"roads\": " << r.roads
+            << ", \"operation\": \"" << r.operation << "\", \"ops\": " << r.ops << ", \"seconds\": " << fixed
+            << setprecision(6) << r.seconds << ", \"ops_per_sec\": " << setprecision(1)
+            << (r.seconds > 0 ? r.ops / r.seconds : 0.0);
+        if (!r.latencies.empty()) {
+            out << setprecision(0) << ", \"p50_ns\": " << percentile(r.latencies, 0.50) << ", \"p90_ns\": "
+                << percentile(r.latencies, 0.90) << ", \"p99_ns\": " << percentile(r.latencies, 0.99)
+                << ", \"max_ns\": " << percentile(r.latencies, 1.0);
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+vector<string> splitList(const string& list) {
+    vector<string> items;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> sizes = {"100", "1000", "10000", "100000", "1000000"};
+    vector<string> generators = {"geometric", "grid", "scalefree"};
+    string format = "csv", outPath;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i], value = argv[i + 1];
+        if (opt == "--sizes") sizes = splitList(value);
+        else if (opt == "--generators") generators = splitList(value);
+        else if (opt == "--format") format = value;
+        else if (opt == "--out") outPath = value;
+        else {
+            cerr << "Error: unknown option " << opt << ".\n";
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || (format != "csv" && format != "json")) {
+        cerr << "Usage: bench [--sizes 100,1000,...] [--generators geometric,grid,scalefree] "
+                "[--format csv|json] [--out file]\n";
+        return 1;
+    }
+
+    vector<Result> results;
+    mt19937_64 rng(20240601); // Fixed seed: runs are comparable
+    for (const string& sizeText : sizes) {
+        uint32_t n = uint32_t(max(2L, atol(sizeText.c_str())));
+        for (const string& generator : generators) {
+            Network net;
+            if (generator == "geometric") net = randomGeometric(n, rng);
+            else if (generator == "grid") net = grid(n, rng);
+            else if (generator == "scalefree") net = scaleFree(n, rng);
+            else {
+                cerr << "Error: unknown generator " << generator << ".\n";
+                return 1;
+            }
+            cerr << generator << ": " << n << " cities, " << net.roads.size() << " roads\n";
+            runSuite(generator, net, results, rng);
+        }
+    }
+
+    ofstream file;
+    if (!outPath.empty()) {
+        file.open(outPath);
+        if (!file) {
+            cerr << "Error: Could not open " << outPath << " for writing.\n";
+            return 1;
+        }
+    }
+    ostream& out = outPath.empty() ? cout : file;
+    if (format == "csv") writeCsv(out, results);
+    else writeJson(out, results);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>   // For fill
+#include <cstdint>     // For fixed-width ids and hashes
+#include <cstring>     // For memcpy
+#include <functional>  // For greater (free-id heap order)
+#include <queue>       // For the free-id heap
+#include <string_view> // Names are handed out as views into the arena
+#include <vector>      // For the arena, the name spans and the hash slots
+
+// City names plus the name -> index lookup.
+//
+// Every name is interned once in a single contiguous arena; a city is just an
+// (offset, length) span into it. Lookups go through an open-addressing hash
+// table (linear probing, at most half full) whose slots hold the city id and
+// the full 32-bit hash, so a probe only compares strings on a hash match and
+// a lookup usually costs one probe and one compare. Removing a name uses
+// backward-shift deletion, so there are no tombstones and renames are O(1).
+//
+// Deleting a city frees its name and puts its id on a free list; the next
+// add() reuses the smallest free id, so ids stay dense without renumbering.
+// compactIds() closes the remaining gaps when the caller can afford to
+// renumber every city (e.g. when a session ends).
+class CityTable {
+public:
+    static constexpr uint32_t kRemoved = 0xFFFFFFFFu; // idMapping() value of a deleted city
+
+    uint32_t size() const { return uint32_t(spans_.size()); } // Id range, deleted ids included
+    bool empty() const { return spans_.empty(); }
+    uint32_t liveCount() const { return size() - deletedCount(); }
+    uint32_t deletedCount() const { return uint32_t(freeIds_.size()); }
+    bool alive(uint32_t i) const { return i < size() && !removed_[i]; }
+    uint32_t nextId() const { return freeIds_.empty() ? size() : freeIds_.top(); } // Index the next add() assigns
+
+    // Name of city i. The view is valid until the next add() or rename().
+    std::string_view operator[](uint32_t i) const {
+        return std::string_view(arena_.data() + spans_[i].offset, spans_[i].length);
+    }
+
+    void reserve(size_t cities, size_t nameBytes = 0) {
+        spans_.reserve(cities);
+        removed_.reserve(cities);
+        arena_.reserve(nameBytes ? nameBytes : cities * 12);
+        if (cities * 2 > slots_.size()) rehash(cities * 2);
+    }
+
+    // Index of the city with this name, or -1
+    int find(std::string_view name) const {
+        if (slots_.empty()) return -1;
+        uint32_t h = hash(name);
+        for (size_t s = h & mask_;; s = (s + 1) & mask_) {
+            const Slot& slot = slots_[s];
+            if (slot.id == kEmpty) return -1;
+            if (slot.hash == h && (*this)[slot.id] == name) return int(slot.id);
+        }
+    }
+
+    // Add a city and return its index: the smallest deleted id if there is
+    // one, else a new id at the end. The caller rejects duplicates.
+    uint32_t add(std::string_view name) {
+        uint32_t id;
+        if (!freeIds_.empty()) {
+            id = freeIds_.top();
+            freeIds_.pop();
+            spans_[id] = intern(name);
+            removed_[id] = false;
+        } else {
+            id = size();
+            spans_.push_back(intern(name));
+            removed_.push_back(false);
+        }
+        if ((size_t(size()) + 1) * 2 > slots_.size()) rehash(slots_.empty() ? 16 : slots_.size() * 2);
+        insertSlot(id, hash((*this)[id]));
+        return id;
+    }
+
+    // Delete city id: its name is no longer found and its id becomes free
+    void remove(uint32_t id) {
+        eraseSlot(id);
+        garbage_ += spans_[id].length;
+        spans_[id] = {0, 0};
+        removed_[id] = true;
+        freeIds_.push(id);
+        if (garbage_ > arena_.size() / 2 && garbage_ > 4096) compactArena();
+    }
+
+    // Old id -> id after compactIds(), kRemoved for deleted cities. Live
+    // cities keep their relative order.
+    std::vector<uint32_t> idMapping() const {
+        std::vector<uint32_t> newId(size(), kRemoved);
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < size(); ++i) {
+            if (!removed_[i]) newId[i] = next++;
+        }
+        return newId;
+    }
+
+    // Renumber the live cities 0 .. liveCount() - 1 and forget deleted ids.
+    // Returns the mapping that was applied (see idMapping()).
+    std::vector<uint32_t> compactIds() {
+        std::vector<uint32_t> newId = idMapping();
+        if (!freeIds_.empty()) renumber(newId);
+        return newId;
+    }
+
+    // Move every live city i to newId[i], which must number the live cities
+    // 0 .. liveCount() - 1 in any order (kRemoved for deleted ones), and
+    // forget deleted ids. The arena is rewritten in the new order.
+    void renumber(const std::vector<uint32_t>& newId) {
+        std::vector<Span> spans(liveCount());
+        for (uint32_t i = 0; i < size(); ++i) {
+            if (newId[i] != kRemoved) spans[newId[i]] = spans_[i];
+        }
+        spans_.swap(spans);
+        removed_.assign(spans_.size(), false);
+        freeIds_ = FreeIds();
+        compactArena();
+        std::fill(slots_.begin(), slots_.end(), Slot{kEmpty, 0}); // Every id moved: re-index from the names
+        for (uint32_t id = 0; id < size(); ++id) insertSlot(id, hash((*this)[id]));
+    }
+
+    // Give city id a new name in O(1): unlink the old name, intern the new one
+    void rename(uint32_t id, std::string_view name) {
+        eraseSlot(id);
+        garbage_ += spans_[id].length;
+        spans_[id] = intern(name);
+        insertSlot(id, hash((*this)[id]));
+        if (garbage_ > arena_.size() / 2 && garbage_ > 4096) compactArena();
+    }
+
+private:
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+    struct Slot {
+        uint32_t id;   // City index, or kEmpty
+        uint32_t hash; // Full hash of the name; the low bits pick the bucket
+    };
+    static constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+
+    static uint32_t hash(std::string_view s) {
+        uint64_t h = 0x9E3779B97F4A7C15ull ^ s.size();
+        size_t i = 0;
+        for (; i + 8 <= s.size(); i += 8) {
+            uint64_t w;
+            std::memcpy(&w, s.data() + i, 8);
+            h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+            h ^= h >> 32;
+        }
+        for (; i < s.size(); ++i) h = (h ^ uint8_t(s[i])) * 0x100000001B3ull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        return uint32_t(h ^ (h >> 29));
+    }
+
+    Span intern(std::string_view name) {
+        // name may point into the arena itself (e.g. renaming to an existing view)
+        if (!arena_.empty() && name.data() >= arena_.data() && name.data() < arena_.data() + arena_.size()) {
+            std::vector<char> copy(name.begin(), name.end());
+            return intern(std::string_view(copy.data(), copy.size()));
+        }
+        Span span{uint32_t(arena_.size()), uint32_t(name.size())};
+        arena_.insert(arena_.end(), name.begin(), name.end());
+        return span;
+    }
+
+    void insertSlot(uint32_t id, uint32_t h) {
+        size_t s = h & mask_;
+        while (slots_[s].id != kEmpty) s = (s + 1) & mask_;
+        slots_[s] = {id, h};
+    }
+
+    void eraseSlot(uint32_t id) {
+        uint32_t h = hash((*this)[id]);
+        size_t s = h & mask_;
+        while (slots_[s].id != id) s = (s + 1) & mask_;
+        // Backward-shift deletion: pull later entries of the probe run into the hole
+        for (size_t next = (s + 1) & mask_;; next = (next + 1) & mask_) {
+            if (slots_[next].id == kEmpty) break;
+            size_t home = slots_[next].hash & mask_;
+            bool movable = ((next - home) & mask_) >= ((next - s) & mask_);
+            if (movable) {
+                slots_[s] = slots_[next];
+                s = next;
+            }
+        }
+        slots_[s].id = kEmpty;
+    }
+
+    void rehash(size_t minSlots) {
+        size_t n = 16;
+        while (n < minSlots) n *= 2;
+        std::vector<Slot> old;
+        old.swap(slots_);
+        slots_.assign(n, Slot{kEmpty, 0});
+        mask_ = n - 1;
+        for (const Slot& slot : old) {
+            if (slot.id != kEmpty) insertSlot(slot.id, slot.hash);
+        }
+    }
+
+    // Drop the bytes of names that were renamed away or deleted
+    void compactArena() {
+        std::vector<char> fresh;
+        fresh.reserve(arena_.size() - garbage_);
+        for (Span& span : spans_) {
+            uint32_t offset = uint32_t(fresh.size());
+            fresh.insert(fresh.end(), arena_.begin() + span.offset, arena_.begin() + span.offset + span.length);
+            span.offset = offset;
+        }
+        arena_.swap(fresh);
+        garbage_ = 0;
+    }
+
+    std::vector<char> arena_; // Every name, back to back
+    std::vector<Span> spans_; // City index -> its name in the arena
+    std::vector<Slot> slots_; // Open-addressing name index
+    size_t mask_ = 0;
+    size_t garbage_ = 0;      // Arena bytes no longer referenced after renames and deletions
+    std::vector<bool> removed_; // City index -> deleted
+    using FreeIds = std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>>;
+    FreeIds freeIds_;           // Deleted ids, smallest on top
+};
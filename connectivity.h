@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm> // For sort
+#include <cstdint>   // For fixed-width ids
+#include <vector>    // For component lists
+#include "road_graph.h" // For rebuilding from the graph
+#include "union_find.h" // The index itself
+
+// "Are these cities linked at all?" index.
+//
+// A union-find over cities that is updated on every road insertion, so a
+// reachability question costs O(alpha(N)) instead of a graph search. Road
+// insertions only ever merge groups, which is exactly what union-find
+// supports incrementally. Removals can split a group, which union-find
+// cannot undo, so they mark the index stale and the owner rebuilds it the
+// next time it is asked a question.
+class ConnectivityIndex {
+public:
+    struct Component {
+        uint32_t representative; // Smallest city id in the group
+        uint32_t size;           // Number of cities
+    };
+
+    // Cover cities [0, n); new cities start out on their own
+    void grow(uint32_t n) {
+        while (groups_.elementCount() < n) groups_.add();
+    }
+
+    void onRoadAdded(uint32_t a, uint32_t b) {
+        if (!stale_) groups_.unite(a, b); // A stale index is rebuilt from the graph anyway
+    }
+
+    // A road or city was removed: answers are wrong until rebuild()
+    void invalidate() { stale_ = true; }
+    bool stale() const { return stale_; }
+
+    // Recompute from scratch, e.g. after a bulk load
+    void rebuild(const RoadGraph& graph) {
+        stale_ = false;
+        groups_.reset(graph.cityCount());
+        graph.forEachRoad([&](uint32_t a, uint32_t b, double) { groups_.unite(a, b); });
+    }
+
+    bool connected(uint32_t a, uint32_t b) { return groups_.connected(a, b); }
+    uint32_t groupOf(uint32_t city) { return groups_.find(city); } // Stable until the next merge
+    uint32_t groupSize(uint32_t city) { return groups_.setSize(city); }
+
+    // Every group, largest first (ties by representative)
+    std::vector<Component> components() {
+        std::vector<Component> result;
+        result.reserve(groups_.setCount());
+        std::vector<uint32_t> slot(groups_.elementCount(), 0xFFFFFFFFu); // Root -> position in result
+        for (uint32_t v = 0; v < groups_.elementCount(); ++v) {
+            uint32_t root = groups_.find(v);
+            if (slot[root] == 0xFFFFFFFFu) {
+                slot[root] = uint32_t(result.size());
+                result.push_back({v, groups_.setSize(root)});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const Component& x, const Component& y) {
+            return x.size != y.size ? x.size > y.size : x.representative < y.representative;
+        });
+        return result;
+    }
+
+private:
+    UnionFind groups_;
+    bool stale_ = false;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cmath>     // For round
+#include <cstdint>   // For bit words and cents
+#include <limits>    // For the cents range
+#include <vector>    // For the bitset and the budget array
+#include "road_graph.h" // Regions are cut out of the sparse graph
+
+// Dense view of a region: a set of cities with most pairs linked, where a
+// matrix beats a sparse graph.
+//
+// Only the upper triangle is stored (pair i < j once): road existence as one
+// bit per pair, packed row by row into 64-bit words, and the budget as a
+// 32-bit count of cents in a parallel array. That is 4 bytes and 1 bit per
+// pair instead of an int and a double per direction (24 bytes). The bits of
+// row i (pairs i, j > i) are contiguous, so degrees come from popcounts of
+// whole words, and the cents array is summed as plain integers, exactly to
+// the cent like the two-decimal budgets in roads.txt.
+class DenseSubnetwork {
+public:
+    static constexpr uint32_t kMaxCents = std::numeric_limits<uint32_t>::max(); // 42.9 million Billion Frw
+
+    // Cut out the cities members[0..n) (local index = position in members).
+    // Roads to cities outside the region are left out. Throws std::bad_alloc
+    // if the triangle does not fit in memory.
+    void build(const RoadGraph& graph, const std::vector<uint32_t>& members) {
+        n_ = uint32_t(members.size());
+        size_t pairs = pairCount();
+        bits_.assign((pairs + 63) / 64, 0);
+        cents_.assign(pairs, 0);
+        roads_ = 0;
+        std::vector<uint32_t> local(graph.cityCount(), kNone);
+        for (uint32_t i = 0; i < n_; ++i) local[members[i]] = i;
+        for (uint32_t i = 0; i < n_; ++i) {
+            graph.forEachNeighbor(members[i], [&](uint32_t v, double budget) {
+                uint32_t j = local[v];
+                if (j == kNone || j <= i) return; // Outside the region, or seen from the other end
+                size_t p = pairIndex(i, j);
+                bits_[p / 64] |= uint64_t(1) << (p % 64);
+                cents_[p] = toCents(budget);
+                ++roads_;
+            });
+        }
+    }
+
+    uint32_t cityCount() const { return n_; }
+    size_t roadCount() const { return roads_; }
+    size_t pairCount() const { return n_ < 2 ? 0 : size_t(n_) * (n_ - 1) / 2; }
+    size_t bytes() const { return bits_.size() * sizeof(uint64_t) + cents_.size() * sizeof(uint32_t); }
+
+    // Roads of every city inside the region: a popcount per word of each row
+    // segment, plus one increment per set bit for the other end of each road
+    std::vector<uint32_t> degrees() const {
+        std::vector<uint32_t> degree(n_, 0);
+        for (uint32_t i = 0; i + 1 < n_; ++i) {
+            size_t begin = pairIndex(i, i + 1), end = begin + (n_ - i - 1);
+            size_t first = i + 1; // Pair begin + k joins i to city first + k
+            forEachWord(begin, end, [&](size_t base, uint64_t word) {
+                degree[i] += uint32_t(__builtin_popcountll(word));
+                for (; word; word &= word - 1) ++degree[first + (base + size_t(__builtin_ctzll(word)) - begin)];
+            });
+        }
+        return degree;
+    }
+
+    // Sum of every road budget in the region, in cents
+    uint64_t totalCents() const {
+        uint64_t total = 0;
+        for (uint32_t c : cents_) total += c; // Vectorized by the compiler
+        return total;
+    }
+
+    static uint32_t toCents(double budget) {
+        if (!(budget > 0)) return 0;
+        double cents = std::round(budget * 100);
+        return cents >= double(kMaxCents) ? kMaxCents : uint32_t(cents);
+    }
+
+private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    // Position of pair (i, j), i < j, in row-major upper-triangle order
+    size_t pairIndex(uint32_t i, uint32_t j) const {
+        return size_t(i) * n_ - size_t(i) * (i + 1) / 2 + (j - i - 1);
+    }
+
+    // fn(position of bit 0, word masked to [begin, end)) for each word the range touches
+    template <class Fn>
+    void forEachWord(size_t begin, size_t end, Fn fn) const {
+        if (begin >= end) return;
+        size_t first = begin / 64, last = (end - 1) / 64;
+        for (size_t w = first; w <= last; ++w) {
+            uint64_t word = bits_[w];
+            if (w == first) word &= ~uint64_t(0) << (begin % 64);
+            if (w == last && end % 64) word &= ~uint64_t(0) >> (64 - end % 64);
+            if (word) fn(w * 64, word);
+        }
+    }
+
+    uint32_t n_ = 0;
+    size_t roads_ = 0;
+    std::vector<uint64_t> bits_;   // Road between pair p: bit p % 64 of word p / 64
+    std::vector<uint32_t> cents_;  // Budget of pair p in cents
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>  // For min
+#include <atomic>     // For the epoch counter and reader slots
+#include <cstdint>    // For fixed-width epochs
+#include <functional> // For deferred frees
+#include <memory>     // For the slot array
+#include <vector>     // For the retired list
+
+// Epoch-based reclamation for data published to lock-free readers.
+//
+// Each reader has a fixed slot. Entering pins the current global epoch in the
+// slot; leaving clears it. The (single) writer unpublishes an object, then
+// retires it with the epoch it bumped the counter from: once every slot is
+// idle or pinned at a later epoch, no reader can still hold the object and it
+// is freed. Readers never wait; only the writer scans the slots.
+class EpochDomain {
+public:
+    explicit EpochDomain(size_t readers) : slots_(new Slot[readers]), readers_(readers) {}
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+    ~EpochDomain() {
+        for (Retired& r : retired_) r.free();
+    }
+
+    // Pins the current epoch for one reader for the guard's lifetime. Load
+    // the published pointer only after constructing the guard.
+    class Guard {
+    public:
+        Guard(EpochDomain& domain, size_t reader) : slot_(domain.slots_[reader].epoch) {
+            slot_.store(domain.global_.load());
+        }
+        ~Guard() { slot_.store(kIdle, std::memory_order_release); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    private:
+        std::atomic<uint64_t>& slot_;
+    };
+
+    // Writer only: call after the object is no longer reachable by new readers
+    void retire(std::function<void()> free) {
+        retired_.push_back({global_.fetch_add(1), std::move(free)});
+        reclaim();
+    }
+
+    // Writer only: free everything no reader can still see
+    void reclaim() {
+        uint64_t oldest = kIdle;
+        for (size_t i = 0; i < readers_; ++i) oldest = std::min(oldest, slots_[i].epoch.load());
+        size_t kept = 0;
+        for (Retired& r : retired_) {
+            if (r.epoch < oldest) r.free();
+            else retired_[kept++] = std::move(r);
+        }
+        retired_.resize(kept);
+    }
+
+private:
+    static constexpr uint64_t kIdle = ~uint64_t(0);
+
+    struct alignas(64) Slot { // One cache line per reader: no false sharing
+        std::atomic<uint64_t> epoch{kIdle};
+    };
+    struct Retired {
+        uint64_t epoch;
+        std::function<void()> free;
+    };
+
+    std::atomic<uint64_t> global_{0};
+    std::unique_ptr<Slot[]> slots_;
+    size_t readers_;
+    std::vector<Retired> retired_;
+};
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <charconv>    // For to_chars / from_chars in the history file
+#include <cstdint>     // For fixed-width node ids
+#include <cstdio>      // For writing the history file
+#include <map>         // For version names
+#include <string>      // For city names inside edits
+#include <string_view> // For parsing
+#include <vector>      // For the version tree
+#include "mapped_file.h" // Loading reads the file in place
+#include "text_format.h" // For nextLine
+
+// Undo/redo and named versions of the network.
+//
+// Versions share the one live network; each version is a node of a tree
+// that stores only the step (the group of edits) leading to it from its
+// parent. Naming a version is O(1): it just remembers a node. Moving
+// between two versions walks the tree path through their common ancestor,
+// undoing the steps on the way up and redoing those on the way down, so
+// undo, redo, switching versions and diffing all cost O(changes) and never
+// copy the network. Editing after an undo starts a new branch; the old
+// branch stays reachable through its names.
+//
+// Edits name cities instead of using their indices, which deletions reuse
+// and the end of a session renumbers. Deleting a city is recorded as the
+// removal of each of its roads followed by the deletion itself, so undoing
+// it brings the roads back with their budgets.
+class EditHistory {
+public:
+    struct Edit {
+        enum Kind : char {
+            AddCity = 'C',
+            DeleteCity = 'D',
+            RenameCity = 'E', // a -> b
+            AddRoad = 'R',
+            RemoveRoad = 'X',
+            SetBudget = 'B',  // previous -> budget
+        };
+        Kind kind;
+        std::string a, b;     // City names (b: second city, or the new name)
+        double budget = 0.0;  // Budget of the road added or removed, or the new budget
+        double previous = 0.0; // SetBudget: the budget it replaced
+
+        Edit inverse() const {
+            switch (kind) {
+                case AddCity: return {DeleteCity, a, b};
+                case DeleteCity: return {AddCity, a, b};
+                case RenameCity: return {RenameCity, b, a};
+                case AddRoad: return {RemoveRoad, a, b, budget};
+                case RemoveRoad: return {AddRoad, a, b, budget};
+                case SetBudget: return {SetBudget, a, b, previous, budget};
+            }
+            return *this;
+        }
+    };
+
+    EditHistory() : nodes_(1) {}
+
+    // Record edits from now on; the current network becomes the root version
+    void start() { recording_ = true; }
+    bool recording() const { return recording_; }
+
+    // Add an edit to the step in progress (ignored while not recording, and
+    // while undo/redo replays edits, so loading costs nothing)
+    void record(Edit::Kind kind, std::string_view a, std::string_view b = {}, double budget = 0.0,
+                double previous = 0.0) {
+        if (recording_ && !applying_) step_.push_back({kind, std::string(a), std::string(b), budget, previous});
+    }
+
+    // Close the step in progress as a new version, child of the current one
+    void endStep() {
+        if (step_.empty()) return;
+        Node node;
+        node.parent = current_;
+        node.depth = nodes_[current_].depth + 1;
+        node.step.swap(step_);
+        nodes_[current_].redo = uint32_t(nodes_.size());
+        current_ = uint32_t(nodes_.size());
+        nodes_.push_back(std::move(node));
+    }
+
+    bool canUndo() const { return current_ != 0; }
+    bool canRedo() const { return nodes_[current_].redo != kNone; }
+
+    // apply(const Edit&) performs one edit on the live network and returns
+    // false if it cannot. Each of these returns false if there is nothing to
+    // do or an edit failed; the edits of the failed step are then reverted,
+    // so the network stays at the last version fully reached, which becomes
+    // the current one.
+    template <class Apply>
+    bool undo(Apply apply) {
+        endStep();
+        return canUndo() && moveTo(nodes_[current_].parent, apply);
+    }
+
+    template <class Apply>
+    bool redo(Apply apply) {
+        endStep();
+        return canRedo() && moveTo(nodes_[current_].redo, apply);
+    }
+
+    template <class Apply>
+    bool checkout(const std::string& name, Apply apply) {
+        endStep();
+        auto it = tags_.find(name);
+        return it != tags_.end() && moveTo(it->second, apply);
+    }
+
+    // Name the current version. Returns false if the name is taken.
+    bool tag(const std::string& name) {
+        endStep();
+        return tags_.emplace(name, current_).second;
+    }
+
+    bool hasTag(const std::string& name) const { return tags_.count(name) != 0; }
+    const std::map<std::string, uint32_t>& tags() const { return tags_; }
+    bool isCurrent(const std::string& name) const {
+        auto it = tags_.find(name);
+        return it != tags_.end() && it->second == current_;
+    }
+
+    // Edits that turn version `from` into version `to`, in order
+    std::vector<Edit> diff(const std::string& from, const std::string& to) {
+        endStep();
+        std::vector<Edit> edits;
+        pathEdits(tags_.at(from), tags_.at(to), [&](const Edit& e) {
+            edits.push_back(e);
+            return true;
+        });
+        return edits;
+    }
+
+    // Write the tree, the names and the current version to path, tied to the
+    // snapshot the live network was just saved as
+    bool save(const std::string& path, uint64_t snapshot) {
+        endStep();
+        std::string out = "H ";
+        appendNumber(out, snapshot);
+        appendNumber(out += ' ', current_);
+        out += '\n';
+        for (uint32_t n = 1; n < nodes_.size(); ++n) {
+            appendNumber(out += "N ", nodes_[n].parent);
+            appendNumber(out += ' ', nodes_[n].redo);
+            out += '\n';
+            for (const Edit& e : nodes_[n].step) {
+                out += char(e.kind);
+                appendNumber(out += ' ', e.budget);
+                appendNumber(out += ' ', e.previous);
+                appendNumber(out += ' ', e.a.size());
+                appendNumber(out += ' ', e.b.size());
+                (out += ' ') += e.a;
+                out += e.b;
+                out += '\n';
+            }
+        }
+        for (const auto& t : tags_) {
+            appendNumber(out += "T ", t.second);
+            (out += ' ') += t.first;
+            out += '\n';
+        }
+        std::string tmpPath = path + ".tmp";
+        FILE* f = std::fopen(tmpPath.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+        if (std::fclose(f) != 0 || !ok) return false;
+#ifdef _WIN32
+        std::remove(path.c_str());
+#endif
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    // Load a tree saved against this snapshot. Returns false (leaving the
+    // history empty) if there is none, it belongs to another snapshot or it
+    // is damaged.
+    bool load(const std::string& path, uint64_t snapshot) {
+        MappedFile file;
+        if (!file.open(path)) return false;
+        const char* p = file.begin();
+        const char* end = file.end();
+        std::string_view line = nextLine(p, end);
+        uint64_t base = 0;
+        uint32_t current = 0;
+        const char* f = line.data() + 2;
+        const char* e = line.data() + line.size();
+        if (line.size() < 2 || line[0] != 'H') return false;
+        f = std::from_chars(f, e, base).ptr;
+        if (base != snapshot || f >= e || std::from_chars(f + 1, e, current).ptr != e) return false;
+
+        std::vector<Node> nodes(1);
+        std::map<std::string, uint32_t> tags;
+        while (p < end) {
+            line = nextLine(p, end);
+            if (line.size() < 2) continue;
+            f = line.data() + 2;
+            e = line.data() + line.size();
+            if (line[0] == 'N') {
+                Node node;
+                f = std::from_chars(f, e, node.parent).ptr;
+                if (f >= e || std::from_chars(f + 1, e, node.redo).ptr != e || node.parent >= nodes.size()) return false;
+                node.depth = nodes[node.parent].depth + 1;
+                nodes.push_back(std::move(node));
+            } else if (line[0] == 'T') {
+                uint32_t n = 0;
+                f = std::from_chars(f, e, n).ptr;
+                if (f >= e || n >= nodes.size()) return false;
+                tags[std::string(f + 1, e)] = n;
+            } else if (nodes.size() > 1) {
+                if (std::string_view("CDERXB").find(line[0]) == std::string_view::npos) return false;
+                Edit edit{Edit::Kind(line[0]), {}, {}};
+                size_t lengthA = 0, lengthB = 0;
+                f = std::from_chars(f, e, edit.budget).ptr;
+                if (f < e) f = std::from_chars(f + 1, e, edit.previous).ptr;
+                if (f < e) f = std::from_chars(f + 1, e, lengthA).ptr;
+                if (f < e) f = std::from_chars(f + 1, e, lengthB).ptr;
+                if (f >= e || size_t(e - f - 1) != lengthA + lengthB) return false;
+                edit.a.assign(f + 1, lengthA);
+                edit.b.assign(f + 1 + lengthA, lengthB);
+                nodes.back().step.push_back(std::move(edit));
+            } else {
+                return false;
+            }
+        }
+        if (current >= nodes.size()) return false;
+        for (uint32_t n = 0; n < nodes.size(); ++n) {
+            uint32_t redo = nodes[n].redo;
+            if (redo != kNone && (redo >= nodes.size() || nodes[redo].parent != n)) return false;
+        }
+        nodes_.swap(nodes);
+        tags_.swap(tags);
+        current_ = current;
+        step_.clear();
+        return true;
+    }
+
+private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    struct Node {
+        uint32_t parent = kNone;
+        uint32_t depth = 0;
+        uint32_t redo = kNone; // Child that redo() returns to
+        std::vector<Edit> step; // Edits from the parent to this version
+    };
+
+    // Visit the edits from version `from` to version `to`: the inverse steps
+    // up to their common ancestor, then the steps down from it
+    template <class Visit>
+    bool pathEdits(uint32_t from, uint32_t to, Visit visit) {
+        std::vector<uint32_t> down;
+        while (nodes_[from].depth > nodes_[to].depth) {
+            if (!visitInverse(from, visit)) return false;
+            from = nodes_[from].parent;
+        }
+        while (nodes_[to].depth > nodes_[from].depth) {
+            down.push_back(to);
+            to = nodes_[to].parent;
+        }
+        while (from != to) {
+            if (!visitInverse(from, visit)) return false;
+            from = nodes_[from].parent;
+            down.push_back(to);
+            to = nodes_[to].parent;
+        }
+        for (size_t i = down.size(); i-- > 0;) {
+            for (const Edit& e : nodes_[down[i]].step) {
+                if (!visit(e)) return false;
+            }
+        }
+        return true;
+    }
+
+    template <class Visit>
+    bool visitInverse(uint32_t node, Visit& visit) {
+        const std::vector<Edit>& step = nodes_[node].step;
+        for (size_t i = step.size(); i-- > 0;) {
+            if (!visit(step[i].inverse())) return false;
+        }
+        return true;
+    }
+
+    // Walk from the current version to target one step at a time, moving
+    // current_ along after every step
+    template <class Apply>
+    bool moveTo(uint32_t target, Apply& apply) {
+        std::vector<uint32_t> down;
+        uint32_t from = current_, to = target;
+        while (nodes_[from].depth > nodes_[to].depth) from = nodes_[from].parent;
+        while (nodes_[to].depth > nodes_[from].depth) {
+            down.push_back(to);
+            to = nodes_[to].parent;
+        }
+        while (from != to) {
+            from = nodes_[from].parent;
+            down.push_back(to);
+            to = nodes_[to].parent;
+        }
+        applying_ = true;
+        bool ok = true;
+        while (ok && current_ != to) {
+            ok = applyStep(current_, true, apply);
+            if (ok) current_ = nodes_[current_].parent;
+        }
+        for (size_t i = down.size(); ok && i-- > 0;) {
+            ok = applyStep(down[i], false, apply);
+            if (!ok) break;
+            nodes_[nodes_[down[i]].parent].redo = down[i]; // Redo from here leads towards the target
+            current_ = down[i];
+        }
+        applying_ = false;
+        return ok;
+    }
+
+    // Apply the step of node (its inverse if backwards) in full, or revert
+    // the edits already applied and return false
+    template <class Apply>
+    bool applyStep(uint32_t node, bool backwards, Apply& apply) {
+        const std::vector<Edit>& step = nodes_[node].step;
+        std::vector<Edit> done;
+        for (size_t k = 0; k < step.size(); ++k) {
+            Edit e = backwards ? step[step.size() - 1 - k].inverse() : step[k];
+            if (!apply(e)) {
+                for (size_t i = done.size(); i-- > 0;) apply(done[i].inverse());
+                return false;
+            }
+            done.push_back(std::move(e));
+        }
+        return true;
+    }
+
+    template <class T>
+    static void appendNumber(std::string& out, T value) {
+        char buf[32];
+        out.append(buf, std::to_chars(buf, buf + sizeof buf, value).ptr);
+    }
+
+    std::vector<Node> nodes_;           // Node 0 is the version history started from
+    std::map<std::string, uint32_t> tags_; // Version name -> node
+    std::vector<Edit> step_;            // Edits since the last endStep()
+    uint32_t current_ = 0;              // Version the live network is at
+    bool recording_ = false;
+    bool applying_ = false;             // Inside undo/redo: edits are not recorded
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+#include <charconv>    // For to_chars / from_chars on budgets and ids
+#include <cstdint>     // For fixed-width city ids
+#include <cstdio>      // For FILE-based appends and remove
+#include <string>      // For the group buffer
+#include <string_view> // For record fields
+#include "mapped_file.h" // Replay reads the journal in place
+#include "metrics.h"     // Commit latency and bytes
+#include "text_format.h" // For nextLine
+
+#ifndef _WIN32
+#include <unistd.h> // For fsync
+#endif
+
+// Append-only write-ahead log of network edits.
+//
+// Every mutation is encoded as one text line:
+//     C <id> <name>           city <id> added
+//     E <id> <name>           city <id> renamed
+//     R <a> <b>               road added
+//     B <a> <b> <budget>      road budget set
+//     D <id>                  city <id> deleted (its roads are removed first)
+//     X <a> <b>               road removed
+//     G <id> <lat> <lon>      city <id> located (nan nan: location cleared)
+//     L <r>                   region r loaded (region sessions)
+//     H <r>                   region r is the one new cities join (region sessions)
+// The first line, S <checksum>, names the snapshot the records apply to:
+// ids are renumbered when a session ends with deleted cities, so the
+// records of an older snapshot must not be replayed on top of a newer one.
+// A region session journals against network.regions instead. Its ids are
+// given out as regions load, so the L records come in load order, and
+// replaying them in that order gives every city its id again.
+// Records are buffered and written with a single fsync per group (commit(),
+// or automatically every kGroupRecords records), so a crash loses at most the
+// group that had not been committed yet. A torn last line is ignored on
+// replay. A checkpoint writes the new snapshot before it resets the
+// journal, so after a crash in between the journal names the old snapshot
+// and is set aside instead of replayed; everything in it is already in the
+// new snapshot.
+class Journal {
+public:
+    static constexpr size_t kGroupRecords = 256;
+
+    Journal() = default;
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+    ~Journal() { close(); }
+
+    // Open the journal for appending. A new journal starts with the checksum
+    // of the snapshot its records will apply to.
+    bool open(const std::string& path, uint64_t snapshot) {
+        close();
+        path_ = path;
+        based_ = readBase(path, base_);
+        baseBytes_ = 0;
+        if (based_) {
+            char buf[32];
+            baseBytes_ = 3 + size_t(std::to_chars(buf, buf + sizeof buf, base_).ptr - buf); // "S <checksum>\n"
+        }
+        file_ = fopen(path.c_str(), "ab");
+        if (!file_) return false;
+        fseek(file_, 0, SEEK_END);
+        bytesOnDisk_ = size_t(ftell(file_));
+        if (bytesOnDisk_ == 0) writeBase(snapshot);
+        return true;
+    }
+
+    void close() {
+        if (!file_) return;
+        commit();
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    void logAddCity(uint32_t id, std::string_view name) { record('C', id, name); }
+    void logRenameCity(uint32_t id, std::string_view name) { record('E', id, name); }
+
+    void logDeleteCity(uint32_t id) {
+        if (!logging()) return;
+        group_ += 'D';
+        appendNumber(id);
+        endRecord();
+    }
+
+    void logRemoveRoad(uint32_t a, uint32_t b) {
+        if (!logging()) return;
+        group_ += 'X';
+        appendNumber(a);
+        appendNumber(b);
+        endRecord();
+    }
+
+    void logAddRoad(uint32_t a, uint32_t b) {
+        if (!logging()) return;
+        group_ += 'R';
+        appendNumber(a);
+        appendNumber(b);
+        endRecord();
+    }
+
+    void logSetBudget(uint32_t a, uint32_t b, double budget) {
+        if (!logging()) return;
+        group_ += 'B';
+        appendNumber(a);
+        appendNumber(b);
+        appendDouble(budget);
+        endRecord();
+    }
+
+    void logLocateCity(uint32_t id, double lat, double lon) {
+        if (!logging()) return;
+        group_ += 'G';
+        appendNumber(id);
+        appendDouble(lat);
+        appendDouble(lon);
+        endRecord();
+    }
+
+    // Region markers: not edits, so not counted by edits() or replay()
+    void logLoadRegion(uint32_t r) { marker('L', r); }
+    void logHomeRegion(uint32_t r) { marker('H', r); }
+
+    // Write the buffered group and fsync it
+    void commit() {
+        if (!file_ || group_.empty()) return;
+        ScopedTimer timer(Metric::JournalCommit);
+        timer.addBytes(group_.size());
+        fwrite(group_.data(), 1, group_.size(), file_);
+        fflush(file_);
+#ifndef _WIN32
+        fsync(fileno(file_));
+#endif
+        bytesOnDisk_ += group_.size();
+        group_.clear();
+        pendingRecords_ = 0;
+    }
+
+    bool isOpen() const { return file_ != nullptr; }
+
+    // Edit records logged while the journal was open
+    size_t edits() const { return edits_; }
+
+    // True if the records apply to the snapshot with this checksum (false for
+    // journals written before the S line existed)
+    bool basedOn(uint64_t snapshot) const { return based_ && base_ == snapshot; }
+
+    // Bytes of records committed since the last reset(); used to decide when
+    // to checkpoint
+    size_t size() const { return bytesOnDisk_ - baseBytes_; }
+
+    // Drop every record once a checkpoint has written them into the snapshot
+    // with this checksum
+    void reset(uint64_t snapshot) {
+        if (!file_) return;
+        group_.clear();
+        pendingRecords_ = 0;
+        file_ = freopen(path_.c_str(), "wb", file_); // Truncate
+        bytesOnDisk_ = 0;
+        if (file_) writeBase(snapshot);
+    }
+
+    // Feed every complete record of the journal at path to handler, which
+    // provides startsFrom(checksum), addCity(id, name), renameCity(id, name),
+    // deleteCity(id), addRoad(a, b), removeRoad(a, b), setBudget(a, b,
+    // budget), locateCity(id, lat, lon), loadRegion(r) and homeRegion(r).
+    // Replay stops if startsFrom() rejects the journal's snapshot.
+    // Returns the number of edit records applied.
+    template <class Handler>
+    static size_t replay(const std::string& path, Handler& handler) {
+        MappedFile file;
+        if (!file.open(path)) return 0;
+        size_t applied = 0;
+        const char* p = file.begin();
+        const char* end = file.end();
+        while (p < end) {
+            std::string_view line = nextLine(p, end);
+            if (p == end && end[-1] != '\n') break; // Torn write at the tail
+            if (line.size() < 2) continue;
+            const char* f = line.data() + 2;
+            const char* e = line.data() + line.size();
+            uint32_t a = 0, b = 0;
+            double budget = 0.0;
+            if (line[0] == 'S') {
+                uint64_t base = 0;
+                std::from_chars(f, e, base);
+                if (!handler.startsFrom(base)) break;
+                continue;
+            }
+            f = std::from_chars(f, e, a).ptr;
+            switch (line[0]) {
+                case 'C':
+                case 'E': {
+                    if (f >= e) continue;
+                    std::string_view name(f + 1, size_t(e - f - 1));
+                    if (line[0] == 'C') handler.addCity(a, name);
+                    else handler.renameCity(a, name);
+                    break;
+                }
+                case 'D':
+                    handler.deleteCity(a);
+                    break;
+                case 'R':
+                case 'X':
+                    if (f >= e) continue;
+                    std::from_chars(f + 1, e, b);
+                    if (line[0] == 'R') handler.addRoad(a, b);
+                    else handler.removeRoad(a, b);
+                    break;
+                case 'B':
+                    if (f >= e) continue;
+                    f = std::from_chars(f + 1, e, b).ptr;
+                    if (f >= e) continue;
+                    std::from_chars(f + 1, e, budget);
+                    handler.setBudget(a, b, budget);
+                    break;
+                case 'G': {
+                    double lat = 0.0, lon = 0.0;
+                    if (f >= e) continue;
+                    f = std::from_chars(f + 1, e, lat).ptr;
+                    if (f >= e) continue;
+                    std::from_chars(f + 1, e, lon);
+                    handler.locateCity(a, lat, lon);
+                    break;
+                }
+                case 'L':
+                    handler.loadRegion(a);
+                    continue;
+                case 'H':
+                    handler.homeRegion(a);
+                    continue;
+                default:
+                    continue;
+            }
+            ++applied;
+        }
+        return applied;
+    }
+
+    // Checksum named by the S line of the journal at path; false if the file
+    // is missing, empty or has no S line
+    static bool readBase(const std::string& path, uint64_t& base) {
+        MappedFile file;
+        if (!file.open(path) || file.size() < 2) return false;
+        const char* p = file.begin();
+        std::string_view line = nextLine(p, file.end());
+        if (line.size() < 3 || line[0] != 'S' || line[1] != ' ') return false;
+        const char* e = line.data() + line.size();
+        return std::from_chars(line.data() + 2, e, base).ptr == e;
+    }
+
+private:
+    void writeBase(uint64_t snapshot) {
+        char buf[32];
+        std::string line = "S ";
+        line.append(buf, std::to_chars(buf, buf + sizeof buf, snapshot).ptr);
+        line += '\n';
+        fwrite(line.data(), 1, line.size(), file_);
+        fflush(file_);
+#ifndef _WIN32
+        fsync(fileno(file_));
+#endif
+        bytesOnDisk_ = baseBytes_ = line.size();
+        base_ = snapshot;
+        based_ = true;
+    }
+
+    // False while not journaling (e.g. while loading or replaying)
+    bool logging() const { return file_ != nullptr; }
+
+    void marker(char tag, uint32_t r) {
+        if (!logging()) return;
+        group_ += tag;
+        appendNumber(r);
+        group_ += '\n';
+        if (++pendingRecords_ >= kGroupRecords) commit();
+    }
+
+    void record(char tag, uint32_t id, std::string_view name) {
+        if (!logging()) return;
+        group_ += tag;
+        appendNumber(id);
+        group_ += ' ';
+        group_ += name;
+        endRecord();
+    }
+
+    void appendNumber(uint32_t value) {
+        char buf[16];
+        group_ += ' ';
+        group_.append(buf, std::to_chars(buf, buf + sizeof buf, value).ptr);
+    }
+
+    void appendDouble(double value) {
+        char buf[32];
+        group_ += ' ';
+        group_.append(buf, std::to_chars(buf, buf + sizeof buf, value).ptr); // Shortest exact form
+    }
+
+    void endRecord() {
+        group_ += '\n';
+        ++edits_;
+        if (++pendingRecords_ >= kGroupRecords) commit();
+    }
+
+    std::string path_;
+    FILE* file_ = nullptr;
+    std::string group_;        // Records not yet written
+    size_t pendingRecords_ = 0;
+    size_t edits_ = 0;
+    size_t bytesOnDisk_ = 0;
+    size_t baseBytes_ = 0;     // Size of the S line at the top
+    uint64_t base_ = 0;        // Checksum of the snapshot the records apply to
+    bool based_ = false;       // The journal has an S line
+};
@@ -4,80 +4,496 @@
 #include <fstream>  // For file input/output
 #include <sstream>  // For string stream operations (parsing lines)
 #include <iomanip>  // For formatting output (setw, fixed, setprecision)
-#include <map>      // For mapping city names to their numerical indices
 #include <limits>   // For numeric_limits (clearing input buffer)
+#include <string_view> // For looking up names without copying them
+#include <cstdio>   // For rename (atomic snapshot replacement)
+#include <chrono>   // For timing batch queries
+#include <cmath>    // For isinf (A* heuristic rate)
+#include <csignal>  // For stopping the query server cleanly
+#include "city_table.h" // Interned city names with a hash index
+#include "road_graph.h" // Sparse CSR road network
+#include "mapped_file.h" // Memory-mapped input files
+#include "text_format.h" // In-place parsers for cities.txt and roads.txt
+#include "journal.h"    // Write-ahead log of edits between checkpoints
+#include "snapshot.h"   // Binary network.bin snapshot
+#include "routing.h"    // Cheapest-route queries
+#include "network_plan.h" // Minimum-cost network planning (spanning forest)
+#include "all_pairs.h"  // All-pairs cheapest budgets (blocked Floyd-Warshall)
+#include "connectivity.h" // Incremental "are these cities linked?" index
+#include "render.h"     // Buffered console output with fast number formatting
+#include "analytics.h"  // Budget statistics and per-city rollups
+#include "metrics.h"    // Scoped timers and the --stats / --metrics reports
+#include "history.h"    // Undo/redo and named versions
+#include "dense_subnetwork.h" // Packed matrix view of a dense region
+#include "spatial_index.h" // City locations and nearest-city queries
+#include "road_selection.h" // Best roads to build within a budget
+#include "name_index.h" // Prefix and typo-tolerant city name search
+#include "partition.h"  // Splitting the network into regions
+#include "region_store.h" // Region shards and their index
+#ifndef _WIN32
+#include "query_server.h" // Local multi-client query daemon (--serve)
+#endif
 
 using namespace std; // Using the standard namespace for brevity
 
 // Global data structures for easy access across functions
-vector<string> cities;      // Stores city names, index + 1 is city ID
-map<string, int> cityNameToIndex;        // Maps city name to its 0-based index
-vector<vector<int>> roadsMatrix;         // Adjacency matrix for roads (0 or 1)
-vector<vector<double>> budgetMatrix;     // Adjacency matrix for road budgets
+CityTable cities;                        // City names and name -> 0-based index lookup, index + 1 is city ID
+RoadGraph roadGraph;                     // Sparse road network with budgets
+Journal journal;                         // Edits since the last checkpoint
+RoutePlanner routePlanner;               // Reusable search state for route queries
+ConnectivityIndex connectivity;          // Groups of cities linked by roads (read through linkedGroups())
+uint64_t snapshotBase = 0;               // Checksum of the network.bin loaded or last written (0: none)
+EditHistory history;                     // Undo/redo and named versions (interactive and --serve sessions)
+vector<GeoPoint> locations;              // City index -> latitude/longitude (unknown past the end)
+SpatialIndex spatialIndex;               // k-d tree over the located cities (read through placedCities())
+NameIndex nameIndex;                     // Tries over the city names (read through searchableNames())
+RegionIndex regionIndex;                 // network.regions, open during a region session (--edit-region)
+vector<vector<uint32_t>> regionCities;   // Region -> city index of each city of its shard (region session)
+vector<char> regionLoaded;               // Region -> loaded yet (region session)
+vector<pair<uint32_t, uint32_t>> cityOrigin; // City index -> (region, position in its shard); kNoRegion: new
+uint32_t homeRegion = 0;                 // Region that cities added in a region session join
+using Edit = EditHistory::Edit;
+
+const char* const kSnapshotPath = "network.bin";
+const char* const kJournalPath = "network.journal";
+const char* const kAllPairsPath = "budget_table.bin";
+const char* const kHistoryPath = "network.history";
+const char* const kRegionIndexPath = "network.regions";
+const char* const kRegionJournalPath = "network.regions.journal";
+const size_t kCheckpointBytes = 8 << 20; // Fold the journal into the snapshot files past 8 MB
+
+bool printStats = false; // --stats: print operation timings on exit
+string metricsPath;      // --metrics <file>: Prometheus text file written on exit
 
 // --- Helper Functions ---
 
-// Function to resize matrices when a new city is added
-void resizeMatrices() {
-    int newSize = cities.size();
-    roadsMatrix.resize(newSize, vector<int>(newSize, 0));
-    budgetMatrix.resize(newSize, vector<double>(newSize, 0.0));
+// Function to grow the road graph when a new city is added (O(1), no matrix rows to touch)
+void resizeRoadGraph() {
+    ScopedTimer timer(Metric::ResizeGraph);
+    roadGraph.resize(cities.size());
+    connectivity.grow(cities.size()); // New cities start in a group of their own
+}
+
+// Add a road to the graph and the connectivity index, and journal it.
+// Returns false if the road already exists.
+bool addRoadBetween(int idx1, int idx2) {
+    if (!roadGraph.addRoad(idx1, idx2)) return false;
+    connectivity.onRoadAdded(idx1, idx2);
+    journal.logAddRoad(idx1, idx2);
+    history.record(Edit::AddRoad, cities[idx1], cities[idx2]);
+    return true;
+}
+
+// Set the budget of an existing road and journal it.
+// Returns false if there is no road between the cities.
+bool setRoadBudget(int idx1, int idx2, double budget) {
+    double previous = roadGraph.getBudget(idx1, idx2);
+    if (!roadGraph.setBudget(idx1, idx2, budget)) return false; // Budget is bidirectional
+    journal.logSetBudget(idx1, idx2, budget);
+    history.record(Edit::SetBudget, cities[idx1], cities[idx2], budget, previous);
+    return true;
+}
+
+// Remove the road between two cities and journal it. The groups may split,
+// so the connectivity index is rebuilt on its next use.
+// Returns false if there is no such road.
+bool removeRoadBetween(int idx1, int idx2) {
+    double budget = roadGraph.getBudget(idx1, idx2);
+    if (!roadGraph.removeRoad(idx1, idx2)) return false;
+    history.record(Edit::RemoveRoad, cities[idx1], cities[idx2], budget);
+    connectivity.invalidate();
+    journal.logRemoveRoad(idx1, idx2);
+    return true;
+}
+
+// Set (or, with an unknown point, clear) the location of city index and
+// journal it. Locations are not part of the undo history.
+void locateCity(uint32_t index, GeoPoint where) {
+    if (locations.size() <= index) locations.resize(cities.size());
+    locations[index] = where;
+    spatialIndex.invalidate();
+    journal.logLocateCity(index, where.lat, where.lon);
+}
+
+// Drop the location of a deleted (or newly added) city without journaling
+void forgetLocation(uint32_t index) {
+    if (index >= locations.size() || !locations[index].known()) return;
+    locations[index] = GeoPoint();
+    spatialIndex.invalidate();
+}
+
+// Delete the city at a 0-based index together with its roads (O(degree)).
+// Its index is reused by the next city added until the session ends and
+// the cities are renumbered.
+void deleteCity(int index) {
+    if (history.recording()) { // Undo has to bring the roads back with their budgets
+        roadGraph.forEachNeighbor(index, [&](uint32_t other, double budget) {
+            history.record(Edit::RemoveRoad, cities[index], cities[other], budget);
+        });
+    }
+    history.record(Edit::DeleteCity, cities[index]);
+    roadGraph.removeRoadsOf(index); // Not journaled one by one: replaying D removes them too
+    nameIndex.erase(index, cities[index]);
+    cities.remove(index);
+    if (size_t(index) < cityOrigin.size()) cityOrigin[index].first = Partition::kNoRegion; // Its index may be reused
+    forgetLocation(index);
+    connectivity.invalidate();
+    journal.logDeleteCity(index);
+}
+
+// The spatial index, rebuilt first if a location changed since it was built
+const SpatialIndex& placedCities() {
+    if (spatialIndex.stale()) spatialIndex.build(locations);
+    return spatialIndex;
+}
+
+// The name index, rebuilt first after a bulk change (loading a region,
+// renumbering); single adds, renames and deletes update it in place
+const NameIndex& searchableNames() {
+    if (nameIndex.stale()) nameIndex.build(cities);
+    return nameIndex;
+}
+
+// The connectivity index, rebuilt first if a removal made it stale
+ConnectivityIndex& linkedGroups() {
+    if (connectivity.stale()) connectivity.rebuild(roadGraph);
+    return connectivity;
+}
+
+// Shard file of region r (0-based)
+string regionPath(uint32_t r) {
+    return "network.region" + to_string(r + 1) + ".bin";
+}
+
+// City index of the city at position pos of region r's shard, or kRemoved if
+// it is not loaded or was deleted in this session
+uint32_t regionMember(uint32_t r, uint32_t pos) {
+    if (!regionLoaded[r]) return CityTable::kRemoved;
+    uint32_t id = regionCities[r][pos];
+    if (id == CityTable::kRemoved || !cities.alive(id) || cityOrigin[id] != make_pair(r, pos)) return CityTable::kRemoved;
+    return id;
+}
+
+// Load region r into a region session: its cities and roads, and the roads
+// between it and the regions loaded before it. Returns false, loading
+// nothing, if its shard is missing or does not match network.regions, or if
+// one of its cities is already loaded: names are unique across regions, so
+// two cities of the same name mean the shards disagree.
+bool loadRegion(uint32_t r) {
+    ScopedTimer timer(Metric::LoadRegion);
+    SnapshotView view;
+    string error, path = regionPath(r);
+    if (!view.open(path, error) || view.checksum() != regionIndex.region(r).checksum) {
+        if (error.empty()) error = string("does not match ") + kRegionIndexPath;
+        cerr << "Error: " << path << " is unusable (" << error << ").\n";
+        return false;
+    }
+    for (uint32_t i = 0; i < view.cityCount(); ++i) {
+        int other = cities.find(view.cityName(i));
+        if (other == -1) continue;
+        cerr << "Error: " << path << " lists '" << view.cityName(i) << "', which is already loaded";
+        if (size_t(other) < cityOrigin.size() && cityOrigin[other].first != Partition::kNoRegion) {
+            cerr << " from region " << cityOrigin[other].first + 1;
+        }
+        cerr << "; region " << r + 1 << " is not loaded.\n";
+        return false;
+    }
+    vector<uint32_t>& members = regionCities[r];
+    members.assign(view.cityCount(), CityTable::kRemoved);
+    cities.reserve(cities.size() + view.cityCount());
+    for (uint32_t i = 0; i < view.cityCount(); ++i) {
+        uint32_t id = cities.add(view.cityName(i)); // Loading is not an edit: not journaled, not undoable
+        members[i] = id;
+        if (cityOrigin.size() <= id) cityOrigin.resize(size_t(id) + 1, {Partition::kNoRegion, 0});
+        cityOrigin[id] = {r, i};
+        forgetLocation(id);
+        if (view.points() && GeoPoint::valid(view.points()[i].lat, view.points()[i].lon)) {
+            if (locations.size() <= id) locations.resize(cities.size());
+            locations[id] = {view.points()[i].lat, view.points()[i].lon};
+        }
+    }
+    regionLoaded[r] = 1;
+    nameIndex.invalidate();
+    spatialIndex.invalidate();
+    resizeRoadGraph();
+
+    vector<RoadGraph::Road> roads;
+    roads.reserve(view.roadCount());
+    for (size_t i = 0; i < view.roadCount(); ++i) {
+        const SnapshotRoad& road = view.roads()[i];
+        if (road.from >= members.size() || road.to >= members.size()) continue;
+        roads.push_back({members[road.from], members[road.to], road.budget});
+    }
+    for (size_t i = 0; i < regionIndex.boundaryCount(); ++i) { // Roads to the regions already loaded
+        const BoundaryRoad& b = regionIndex.boundary()[i];
+        if (b.fromRegion != r && b.toRegion != r) continue;
+        uint32_t from = regionMember(b.fromRegion, b.fromCity), to = regionMember(b.toRegion, b.toCity);
+        if (from != CityTable::kRemoved && to != CityTable::kRemoved) roads.push_back({from, to, b.budget});
+    }
+    roadGraph.addRoadsBulk(roads); // Drops the roads of cities left out (kRemoved)
+    connectivity.invalidate(); // Bulk loads bypass the incremental updates
+    journal.logLoadRegion(r); // Replaying the session's journal has to load it at the same point
+    return true;
+}
+
+// During a region session, load the regions with a city of this name that
+// are not loaded yet. Returns true if one was loaded.
+bool loadRegionsNamed(string_view cityName) {
+    bool loaded = false;
+    regionIndex.forEachNamed(cityName, [&](uint32_t r, uint32_t) {
+        if (regionLoaded[r] || !loadRegion(r)) return;
+        cout << "Loaded region " << r + 1 << " (" << regionIndex.region(r).cities << " cities) for '" << cityName
+             << "'.\n";
+        loaded = true;
+    });
+    return loaded;
+}
+
+// Get city index by name among the cities in memory (-1 if not found)
+int getCityIndex(string_view cityName) {
+    ScopedTimer timer(Metric::FindCity);
+    return cities.find(cityName);
+}
+
+// Get city index by name for an edit or a query. During a region session, a
+// name that is not loaded yet loads its region first.
+int resolveCity(string_view cityName) {
+    int index = getCityIndex(cityName);
+    if (index == -1 && regionIndex.isOpen() && loadRegionsNamed(cityName)) index = getCityIndex(cityName);
+    return index;
+}
 
-    // Re-initialize new rows/cols to 0 (important if growing existing)
-    for (int i = 0; i < newSize; ++i) {
-        roadsMatrix[i].resize(newSize, 0);
-        budgetMatrix[i].resize(newSize, 0.0);
+// After a failed lookup: if no city is called cityName, print the closest
+// names ("Did you mean ...?"), if any is a few typos away
+void suggestCity(const string& cityName) {
+    if (getCityIndex(cityName) != -1) return;
+    auto close = searchableNames().similar(cityName, NameIndex::defaultEdits(cityName.size()), 3);
+    if (close.empty()) return;
+    cout << "No city is named '" << cityName << "'. Did you mean ";
+    for (size_t i = 0; i < close.size(); ++i) {
+        if (i > 0) cout << (i + 1 == close.size() ? " or " : ", ");
+        cout << "'" << cities[close[i].first] << "'";
     }
+    cout << "?\n";
 }
 
-// Get city index by name
-int getCityIndex(const string& cityName) {
-    if (cityNameToIndex.count(cityName)) {
-        return cityNameToIndex[cityName];
+// Move a fully written temporary file over its target in one step, so a crash
+// never leaves a half-written snapshot behind
+bool replaceFile(const string& tmpPath, const string& path) {
+#ifdef _WIN32
+    remove(path.c_str()); // rename() does not overwrite on Windows
+#endif
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        cerr << "Error: Could not replace " << path << ".\n";
+        return false;
     }
-    return -1; // Not found
+    return true;
 }
 
 // Save cities to cities.txt
-void saveCitiesToFile() {
-    ofstream outFile("cities.txt");
+bool saveCitiesToFile() {
+    ScopedTimer timer(Metric::SaveCities);
+    ofstream outFile("cities.txt.tmp");
     if (!outFile.is_open()) {
         cerr << "Error: Could not open cities.txt for writing.\n";
-        return;
+        return false;
+    }
+    bool located = false;
+    for (uint32_t i = 0; i < cities.size() && i < locations.size() && !located; ++i) {
+        located = cities.alive(i) && locations[i].known();
     }
-    outFile << "Index Cityname\n"; // Header
-    for (size_t i = 0; i < cities.size(); ++i) {
-        outFile << i + 1 << " " << cities[i] << "\n";
+    outFile << (located ? kLocatedCitiesHeader : "Index Cityname") << "\n"; // Header
+    uint32_t index = 0; // Deleted cities are left out, so the file is numbered 1..N
+    auto degrees = [&](double value) {
+        char buf[32];
+        if (isnan(value)) outFile << " -";
+        else outFile << ' ' << string_view(buf, to_chars(buf, buf + sizeof buf, value).ptr - buf);
+    };
+    for (uint32_t i = 0; i < cities.size(); ++i) {
+        if (!cities.alive(i)) continue;
+        outFile << ++index << " " << cities[i];
+        if (located) {
+            GeoPoint where = i < locations.size() ? locations[i] : GeoPoint();
+            degrees(where.lat);
+            degrees(where.lon);
+        }
+        outFile << "\n";
     }
+    timer.addBytes(uint64_t(outFile.tellp()));
     outFile.close();
+    if (!outFile || !replaceFile("cities.txt.tmp", "cities.txt")) return false;
     cout << "Cities saved to cities.txt.\n";
+    return true;
 }
 
 // Save roads and budgets to roads.txt
-void saveRoadsToFile() {
-    ofstream outFile("roads.txt");
+bool saveRoadsToFile() {
+    ScopedTimer timer(Metric::SaveRoads);
+    ofstream outFile("roads.txt.tmp");
     if (!outFile.is_open()) {
         cerr << "Error: Could not open roads.txt for writing.\n";
-        return;
+        return false;
+    }
+    writeRoadsText(outFile, roadGraph, [](uint32_t i) { return cities[i]; });
+    timer.addBytes(uint64_t(outFile.tellp()));
+    outFile.close();
+    if (!outFile || !replaceFile("roads.txt.tmp", "roads.txt")) return false;
+    cout << "Roads and budgets saved to roads.txt.\n";
+    return true;
+}
+
+// Save the whole network to network.bin (written to a temporary file first).
+// Cities keep their indices, so the gaps deleted cities left are stored too
+// and the journal that follows a checkpoint goes on using the same indices.
+bool saveSnapshot() {
+    ScopedTimer timer(Metric::SaveSnapshot);
+    string tmpPath = string(kSnapshotPath) + ".tmp";
+    uint64_t checksum = 0;
+    vector<uint32_t> deleted;
+    for (uint32_t i = 0; i < cities.size() && deleted.size() < cities.deletedCount(); ++i) {
+        if (!cities.alive(i)) deleted.push_back(i);
+    }
+    bool ok = writeSnapshot(tmpPath, cities.size(), [](uint32_t i) { return cities[i]; }, roadGraph, deleted, &checksum,
+                            locations);
+    if (!ok) {
+        cerr << "Error: Could not write " << tmpPath << ".\n";
+        return false;
+    }
+    timer.addBytes(uint64_t(ifstream(tmpPath, ios::binary | ios::ate).tellg()));
+    if (!replaceFile(tmpPath, kSnapshotPath)) return false;
+    snapshotBase = checksum;
+    cout << "Network saved to " << kSnapshotPath << ".\n";
+    return true;
+}
+
+// Move the roads and locations of every city to the index newId[i] the city
+// table just gave it
+void renumberCities(const vector<uint32_t>& newId) {
+    roadGraph.renumber(newId, cities.size());
+    vector<GeoPoint> moved(cities.size());
+    for (uint32_t i = 0; i < locations.size() && i < newId.size(); ++i) {
+        if (newId[i] != CityTable::kRemoved) moved[newId[i]] = locations[i];
+    }
+    locations.swap(moved);
+    connectivity.invalidate();
+    spatialIndex.invalidate();
+    nameIndex.invalidate();
+}
+
+// Close the gaps deleted cities left in the index range, renumbering the
+// remaining cities. Indices people hold change, so this only runs when a
+// session ends. O(cities + roads).
+void compactCityIds() {
+    if (cities.deletedCount() == 0) return;
+    uint32_t before = cities.size();
+    renumberCities(cities.compactIds());
+    cout << "Renumbered the cities to close " << before - cities.size() << " gaps left by deletions.\n";
+}
+
+// Fold the journal into network.bin and start a fresh journal. The journal
+// is only truncated once the new snapshot is safely in place; it then names
+// that snapshot.
+void checkpoint() {
+    journal.commit();
+    if (!saveSnapshot()) return;
+    journal.reset(snapshotBase);
+}
+
+// End of an edit: close it as one undo step, make the journaled records
+// durable (one fsync for the whole group) and checkpoint once the journal
+// has grown large
+void commitChanges() {
+    history.endStep();
+    journal.commit();
+    if (journal.size() > kCheckpointBytes && !regionIndex.isOpen()) checkpoint(); // Region sessions save on exit
+}
+
+// Append a city without touching the road graph or the disk.
+// Returns false if the name is already taken.
+bool appendCity(string_view cityName) {
+    if (resolveCity(cityName) != -1) return false;
+    uint32_t index = cities.add(cityName); // Interns the name and indexes it
+    nameIndex.insert(index, cityName);
+    forgetLocation(index); // A reused index must not inherit the deleted city's location
+    journal.logAddCity(index, cityName);
+    history.record(Edit::AddCity, cityName);
+    return true;
+}
+
+// Rename the city at a 0-based index (the name index follows in O(1)).
+// Returns false if another city already has the new name.
+bool renameCity(int index, string_view newName) {
+    int owner = resolveCity(newName);
+    if (owner != -1) return owner == index; // Renaming a city to its own name changes nothing
+    history.record(Edit::RenameCity, cities[index], newName);
+    nameIndex.erase(index, cities[index]);
+    cities.rename(index, newName);
+    nameIndex.insert(index, newName);
+    journal.logRenameCity(index, newName);
+    return true;
+}
+
+// Add a batch of cities: reserve once, grow the road graph once and commit once.
+// Returns the number of cities added; duplicates are skipped. If isNew is
+// given, (*isNew)[i] tells whether names[i] was added.
+int addCitiesBatch(const vector<string>& names, vector<char>* isNew = nullptr) {
+    cities.reserve(cities.size() + names.size()); // One reallocation for the whole batch
+    if (isNew) isNew->assign(names.size(), 0);
+    int added = 0;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (!appendCity(names[i])) continue;
+        if (isNew) (*isNew)[i] = 1;
+        ++added;
+    }
+    if (added > 0) {
+        resizeRoadGraph();
+        commitChanges();
+    }
+    return added;
+}
+
+// Read city names from a file for --import-cities. Accepts either one name per
+// line or the cities.txt layout ("Index Cityname" header, then "<index> <name>",
+// with "<lat> <lon>" after the name under the longer header; those go to
+// where, one per name).
+bool readCityNames(const string& path, vector<string>& names, vector<GeoPoint>& where) {
+    ifstream inFile(path);
+    if (!inFile.is_open()) {
+        cerr << "Error: Could not open " << path << " for reading.\n";
+        return false;
     }
-    outFile << "Nbr Road Budget\n"; // Header
-    int road_nbr = 1;
-    for (size_t i = 0; i < cities.size(); ++i) {
-        for (size_t j = i + 1; j < cities.size(); ++j) { // Only half matrix
-            if (roadsMatrix[i][j] == 1) {
-                outFile << road_nbr++ << ". " << cities[i] << "-" << cities[j]
-                        << " " << fixed << setprecision(2) << budgetMatrix[i][j] << "\n";
+    string line;
+    bool indexed = false, located = false;
+    bool firstLine = true;
+    while (getline(inFile, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back(); // Files saved on Windows
+        if (firstLine) {
+            firstLine = false;
+            located = line == kLocatedCitiesHeader;
+            if (located || line == "Index Cityname") { // cities.txt header
+                indexed = true;
+                continue;
             }
         }
+        GeoPoint point;
+        string_view rest = line;
+        if (located && !splitLocation(rest, point.lat, point.lon)) continue;
+        if (indexed) {
+            size_t space = rest.find(' ');
+            rest = space == string::npos ? "" : rest.substr(space + 1);
+        }
+        if (rest.empty()) continue;
+        names.emplace_back(rest);
+        where.push_back(point);
     }
-    outFile.close();
-    cout << "Roads and budgets saved to roads.txt.\n";
+    return true;
 }
 
 // --- Menu Functions ---
 
 // Menu 1: Add new City(ies)
 void addNewCities() {
+    ScopedTimer timer(Metric::AddCity);
     int numCitiesToAdd;
     cout << "Enter the number of cities to add: ";
     while (!(cin >> numCitiesToAdd) || numCitiesToAdd <= 0) {
@@ -87,49 +503,53 @@ void addNewCities() {
     }
     cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
 
+    cities.reserve(cities.size() + numCitiesToAdd);
     for (int i = 0; i < numCitiesToAdd; ++i) {
         string cityName;
-        cout << "Enter name of city " << cities.size() + 1 << ": ";
+        cout << "Enter name of city " << cities.nextId() + 1 << ": ";
         getline(cin, cityName);
         
         // Simple check for duplicate names (can be improved)
-        if (getCityIndex(cityName) != -1) {
+        if (resolveCity(cityName) != -1) {
             cout << "City '" << cityName << "' already exists. Skipping.\n";
             i--; // Decrement to re-prompt for this city
             continue;
         }
 
-        cities.push_back(cityName);
-        cityNameToIndex[cityName] = cities.size() - 1; // Map new city to its index
-        resizeMatrices(); // Resize matrices for new city
-        cout << "City '" << cityName << "' added with index " << cities.size() << ".\n";
+        uint32_t index = cities.nextId();
+        appendCity(cityName);
+        cout << "City '" << cityName << "' added with index " << index + 1 << ".\n";
     }
-    saveCitiesToFile(); // Save after adding cities
+    resizeRoadGraph(); // Make room for the new cities in the road graph
+    commitChanges(); // Journal the whole batch with one flush
 }
 
 // Menu 2: Add roads between cities
 void addRoads() {
+    ScopedTimer timer(Metric::AddRoad);
     string city1Name, city2Name;
     cout << "Enter the name of the first City: ";
     getline(cin, city1Name);
     cout << "Enter the name of the second City: ";
     getline(cin, city2Name);
 
-    int idx1 = getCityIndex(city1Name);
-    int idx2 = getCityIndex(city2Name);
+    int idx1 = resolveCity(city1Name);
+    int idx2 = resolveCity(city2Name);
 
     if (idx1 != -1 && idx2 != -1 && idx1 != idx2) {
-        roadsMatrix[idx1][idx2] = 1;
-        roadsMatrix[idx2][idx1] = 1; // Roads are bidirectional
+        addRoadBetween(idx1, idx2); // Roads are bidirectional
         cout << "Road added between " << city1Name << " and " << city2Name << ".\n";
     } else {
         cout << "Error: One or both cities not found, or same city.\n";
+        suggestCity(city1Name);
+        suggestCity(city2Name);
     }
-    saveRoadsToFile(); // Save after adding roads
+    commitChanges(); // Journal the new road
 }
 
 // Menu 3: Add the budget for roads
 void addBudgetForRoads() {
+    ScopedTimer timer(Metric::SetBudget);
     string city1Name, city2Name;
     double budget;
     cout << "Enter the name of the first City: ";
@@ -137,11 +557,11 @@ void addBudgetForRoads() {
     cout << "Enter the name of the second City: ";
     getline(cin, city2Name);
 
-    int idx1 = getCityIndex(city1Name);
-    int idx2 = getCityIndex(city2Name);
+    int idx1 = resolveCity(city1Name);
+    int idx2 = resolveCity(city2Name);
 
     if (idx1 != -1 && idx2 != -1 && idx1 != idx2) {
-        if (roadsMatrix[idx1][idx2] == 1) { // Check if road exists
+        if (roadGraph.hasRoad(idx1, idx2)) { // Check if road exists
             cout << "Enter the budget for the road (in Billion Frw): ";
             while (!(cin >> budget) || budget < 0) {
                 cout << "Invalid input. Please enter a non-negative number: ";
@@ -150,24 +570,38 @@ void addBudgetForRoads() {
             }
             cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
 
-            budgetMatrix[idx1][idx2] = budget;
-            budgetMatrix[idx2][idx1] = budget; // Budget is bidirectional
+            setRoadBudget(idx1, idx2, budget);
             cout << "Budget added for the road between " << city1Name << " and " << city2Name << ".\n";
         } else {
             cout << "Error: No road exists between " << city1Name << " and " << city2Name << ".\n";
         }
     } else {
         cout << "Error: One or both cities not found, or same city.\n";
+        suggestCity(city1Name);
+        suggestCity(city2Name);
+    }
+    commitChanges(); // Journal the new budget
+}
+
+// Prompt again after an index that names no city. Deleted cities leave
+// gaps in the range until the session ends, so say when that is the reason.
+void reportBadIndex(int index) {
+    if (cin && index > 0 && uint32_t(index) <= cities.size()) {
+        cout << "City " << index << " was deleted. Please enter the index of an existing city: ";
+    } else if (cities.deletedCount() > 0) {
+        cout << "Invalid index. Please enter a number between 1 and " << cities.size() << " (not a deleted city): ";
+    } else {
+        cout << "Invalid index. Please enter a number between 1 and " << cities.size() << ": ";
     }
-    saveRoadsToFile(); // Save after adding budget
 }
 
 // Menu 4: Edit city name
 void editCity() {
+    ScopedTimer timer(Metric::EditCity);
     int indexToEdit;
     cout << "Enter the index for the city to edit: ";
-    while (!(cin >> indexToEdit) || indexToEdit <= 0 || indexToEdit > cities.size()) {
-        cout << "Invalid index. Please enter a number between 1 and " << cities.size() << ": ";
+    while (!(cin >> indexToEdit) || indexToEdit <= 0 || !cities.alive(indexToEdit - 1)) {
+        reportBadIndex(indexToEdit);
         cin.clear();
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
     }
@@ -177,21 +611,22 @@ void editCity() {
     cout << "Enter the new name for City " << indexToEdit << ": ";
     getline(cin, newName);
 
-    // Update map and vector
-    cityNameToIndex.erase(cities[indexToEdit - 1]); // Remove old mapping
-    cities[indexToEdit - 1] = newName;
-    cityNameToIndex[newName] = indexToEdit - 1; // Add new mapping
+    if (!renameCity(indexToEdit - 1, newName)) { // Update map and vector
+        cout << "Error: City '" << newName << "' already exists.\n";
+        return;
+    }
 
     cout << "City updated successfully.\n";
-    saveCitiesToFile(); // Save after editing city
+    commitChanges(); // Journal the rename
 }
 
 // Menu 5: Search for a city using index
 void searchCityByIndex() {
+    ScopedTimer timer(Metric::SearchCity);
     int indexToSearch;
     cout << "Enter the index of the city to search: ";
-    while (!(cin >> indexToSearch) || indexToSearch <= 0 || indexToSearch > cities.size()) {
-        cout << "Invalid index. Please enter a number between 1 and " << cities.size() << ": ";
+    while (!(cin >> indexToSearch) || indexToSearch <= 0 || !cities.alive(indexToSearch - 1)) {
+        reportBadIndex(indexToSearch);
         cin.clear();
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
     }
@@ -200,109 +635,2126 @@ void searchCityByIndex() {
     cout << "City at index " << indexToSearch << ": " << cities[indexToSearch - 1] << endl;
 }
 
-// Menu 6: Display cities
-void displayCities() {
-    cout << "\nCities:\n---------------------\n";
-    if (cities.empty()) {
-        cout << "No cities recorded yet.\n";
+// --- Console Rendering ---
+
+const uint32_t kFullMatrixLimit = 40; // Larger networks ask which view to show
+const uint32_t kPageRows = 50;        // Rows per page when paging
+
+// Which part of a matrix to show, and how
+struct MatrixView : MatrixWindow {
+    bool edgesOnly = false; // List the roads instead of the matrix
+    bool paged = false;     // Pause every kPageRows rows
+};
+
+// Counts rendered rows and pauses between pages. Returns false once the
+// user asks to stop.
+struct Pager {
+    OutputBuffer& out;
+    bool enabled;
+    uint32_t rows = 0;
+
+    bool row() {
+        if (!enabled || ++rows % kPageRows != 0) return true;
+        out.flush();
+        cout << "-- More (Enter to continue, q to stop) --";
+        string answer;
+        if (!getline(cin, answer)) return false;
+        return answer != "q" && answer != "Q";
+    }
+};
+
+// Read a 1-based inclusive range "first last" within [1, count]
+void readRange(const char* what, uint32_t count, uint32_t& begin, uint32_t& end) {
+    long first, last;
+    cout << "Enter the first and last " << what << " (1-" << count << "): ";
+    while (!(cin >> first >> last) || first < 1 || last < first || last > long(count)) {
+        cout << "Invalid range. Please enter two numbers between 1 and " << count << ": ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
+    begin = uint32_t(first - 1);
+    end = uint32_t(last);
+}
+
+// Small networks are shown whole; for larger ones the user picks a view so
+// the display does not turn into O(N^2) terminal output
+MatrixView chooseMatrixView() {
+    MatrixView view;
+    view.rowEnd = view.colEnd = cities.size();
+    if (cities.size() <= kFullMatrixLimit) return view;
+
+    int option;
+    cout << "The network has " << cities.size() << " cities. Show:\n";
+    cout << "1. Roads only (list)\n2. A window of the matrix\n3. The full matrix\nEnter your choice: ";
+    while (!(cin >> option) || option < 1 || option > 3) {
+        cout << "Invalid input. Please enter 1, 2 or 3: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
+    view.paged = true;
+    view.edgesOnly = option == 1;
+    if (option == 2) {
+        readRange("rows", cities.size(), view.rowBegin, view.rowEnd);
+        readRange("columns", cities.size(), view.colBegin, view.colEnd);
+    }
+    return view;
+}
+
+void renderCities(OutputBuffer& out) {
+    out.text("\nCities:\n---------------------\n");
+    if (cities.liveCount() == 0) {
+        out.text("No cities recorded yet.\n");
+        return;
+    }
+    for (uint32_t i = 0; i < cities.size(); ++i) {
+        if (cities.alive(i)) out.integer(i + 1).text(". ").text(cities[i]).ch('\n');
+    }
+}
+
+// Sparse view: one line per road, in the roads.txt layout
+void renderRoadList(OutputBuffer& out, const MatrixView& view) {
+    out.text("\nRoads\n-----\n");
+    if (roadGraph.roadCount() == 0) {
+        out.text("No roads recorded yet.\n");
         return;
     }
-    for (size_t i = 0; i < cities.size(); ++i) {
-        cout << i + 1 << ". " << cities[i] << "\n";
+    Pager pager{out, view.paged};
+    renderRoadLines(out, roadGraph, [](uint32_t i) { return cities[i]; }, [&] { return pager.row(); });
+}
+
+// Deleted cities get neither a row nor a column of a matrix view
+bool cityShown(uint32_t i) {
+    return cities.alive(i);
+}
+
+string_view cityNameAt(uint32_t i) {
+    return cities[i];
+}
+
+void renderRoads(OutputBuffer& out, const MatrixView& view) {
+    if (view.edgesOnly) {
+        renderRoadList(out, view);
+        return;
     }
+    out.text("\nRoads Adjacency Matrix\n----------------------\n");
+    Pager pager{out, view.paged};
+    renderMatrix(out, roadGraph, view, 3, 3, cityShown, cityNameAt,
+                 [&](long slot) { out.integerField(slot != -1 ? 1 : 0, 3); }, [&] { return pager.row(); });
+}
+
+void renderBudgets(OutputBuffer& out, const MatrixView& view) {
+    if (view.edgesOnly) return; // The road list already shows budgets
+    out.text("\nBudgets Adjacency Matrix\n------------------------\n");
+    Pager pager{out, view.paged};
+    renderBudgetMatrix(out, roadGraph, view, cityShown, cityNameAt, [&] { return pager.row(); });
+}
+
+// Menu 6: Display cities
+void displayCities() {
+    ScopedTimer timer(Metric::DisplayCities);
+    OutputBuffer out;
+    renderCities(out);
 }
 
 // Menu 7: Display roads adjacency matrix
 void displayRoadsMatrix() {
+    ScopedTimer timer(Metric::DisplayRoads);
+    if (cities.empty()) {
+        cout << "No cities to display roads for. Add cities first.\n";
+        return;
+    }
+    MatrixView view = chooseMatrixView();
+    OutputBuffer out;
+    renderCities(out); // Show cities before roads
+    renderRoads(out, view);
+}
+
+// Menu 8: Display all recorded data (cities, roads, budgets)
+void displayAllData() {
+    ScopedTimer timer(Metric::DisplayAll);
     if (cities.empty()) {
+        displayCities();
         cout << "No cities to display roads for. Add cities first.\n";
+        cout << "No cities to display budgets for.\n";
+        return;
+    }
+    MatrixView view = chooseMatrixView();
+    OutputBuffer out;
+    renderCities(out);
+    renderCities(out); // The roads view lists the cities again, as before
+    renderRoads(out, view);
+    renderBudgets(out, view);
+}
+
+// Lowest budget per km of road over every road, as the A* heuristic's rate,
+// or -1 if some road has an end without a location: the heuristic is only a
+// lower bound if it bounds every road the search may take
+double minBudgetPerKm() {
+    double rate = numeric_limits<double>::infinity();
+    bool bounded = true;
+    roadGraph.forEachRoad([&](uint32_t a, uint32_t b, double budget) {
+        if (a >= locations.size() || b >= locations.size() || !locations[a].known() || !locations[b].known()) {
+            bounded = false;
+            return;
+        }
+        double km = distanceKm(locations[a], locations[b]);
+        if (km > 0) rate = min(rate, budget / km);
+    });
+    if (!bounded || isinf(rate)) return -1;
+    return rate * (1 - 1e-9); // Slack for rounding, so the bound never overestimates
+}
+
+// Cheapest route from a to b on the compacted graph: A* towards b's location
+// when rate (from minBudgetPerKm()) bounds every road and b is located,
+// bidirectional Dijkstra otherwise
+RouteResult cheapestRoute(uint32_t a, uint32_t b, double rate) {
+    if (rate < 0 || b >= locations.size() || !locations[b].known()) {
+        return routePlanner.bidirectional(roadGraph, a, b);
+    }
+    GeoPoint goal = locations[b];
+    return routePlanner.astar(roadGraph, a, b, [&](uint32_t v) {
+        return v < locations.size() && locations[v].known() ? rate * distanceKm(locations[v], goal) : 0.0;
+    });
+}
+
+// Menu 26: Find the cheapest route between two cities
+void findCheapestRoute() {
+    ScopedTimer timer(Metric::Route);
+    string city1Name, city2Name;
+    cout << "Enter the name of the starting City: ";
+    getline(cin, city1Name);
+    cout << "Enter the name of the destination City: ";
+    getline(cin, city2Name);
+
+    int idx1 = resolveCity(city1Name);
+    int idx2 = resolveCity(city2Name);
+    if (idx1 == -1 || idx2 == -1) {
+        cout << "Error: One or both cities not found.\n";
+        suggestCity(city1Name);
+        suggestCity(city2Name);
+        return;
+    }
+
+    RouteResult route;
+    if (linkedGroups().connected(idx1, idx2)) { // Skip a search that would exhaust a whole group
+        roadGraph.compact(); // Searches walk the CSR rows directly
+        route = cheapestRoute(idx1, idx2, minBudgetPerKm());
+    }
+    if (!route.found) {
+        cout << "No route connects " << city1Name << " and " << city2Name << ".\n";
         return;
     }
-    displayCities(); // Show cities before roads
-    cout << "\nRoads Adjacency Matrix\n----------------------\n";
-    // Print header (city names)
-    cout << setw(15) << ""; // Space for row headers
-    for (const auto& city : cities) {
-        cout << setw(3) << left << city.substr(0, 3); // Abbreviate city names
+    cout << "Cheapest route (" << fixed << setprecision(2) << route.cost << " Billion Frw): ";
+    for (size_t i = 0; i < route.path.size(); ++i) {
+        cout << (i ? " -> " : "") << cities[route.path[i]];
     }
     cout << "\n";
+}
+
+// Print roads in the roads.txt layout
+void printRoadList(const vector<RoadGraph::Road>& roads) {
+    string out; // Whole report, written once
+    char buf[32];
+    for (size_t i = 0; i < roads.size(); ++i) {
+        const RoadGraph::Road& r = roads[i];
+        out += to_string(i + 1) + ". ";
+        out += cities[r.from];
+        out += '-';
+        out += cities[r.to];
+        out += ' ';
+        out.append(buf, to_chars(buf, buf + sizeof buf, r.budget, chars_format::fixed, 2).ptr);
+        out += '\n';
+    }
+    cout << out;
+}
+
+// Print a network plan in the roads.txt layout, followed by its total
+void printNetworkPlan(const NetworkPlan& plan) {
+    printRoadList(plan.roads);
+    cout << "Selected " << plan.roads.size() << " roads, total budget " << fixed << setprecision(2)
+         << plan.totalBudget << " Billion Frw.\n";
+    uint32_t groups = plan.components - cities.deletedCount(); // Deleted cities count as lone groups
+    if (groups > 1) {
+        cout << "Note: the cities form " << groups << " separate groups that no road links.\n";
+    }
+}
 
-    for (size_t i = 0; i < roadsMatrix.size(); ++i) {
-        cout << setw(15) << left << cities[i];
-        for (size_t j = 0; j < roadsMatrix[i].size(); ++j) {
-            cout << setw(3) << roadsMatrix[i][j];
+// Menu 10: Plan the cheapest set of roads connecting all cities
+void planCheapestNetwork() {
+    ScopedTimer timer(Metric::Plan);
+    if (roadGraph.roadCount() == 0) {
+        cout << "No roads recorded yet.\n";
+        return;
+    }
+    int algorithm;
+    cout << "Algorithm (1 = Kruskal, 2 = parallel Boruvka): ";
+    while (!(cin >> algorithm) || (algorithm != 1 && algorithm != 2)) {
+        cout << "Invalid input. Please enter 1 or 2: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
+
+    roadGraph.compact();
+    cout << "\nCheapest Road Network\n---------------------\n";
+    printNetworkPlan(algorithm == 1 ? planKruskal(roadGraph) : planBoruvka(roadGraph));
+}
+
+// Read priority cities for --optimize: one name per line, optionally
+// followed by ",<weight>" (default 1). Unknown names are reported and skipped.
+bool readPriorities(const string& path, vector<double>& weight) {
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Error: Could not open " << path << " for reading.\n";
+        return false;
+    }
+    weight.assign(cities.size(), 0.0);
+    size_t unknown = 0;
+    for (const char* p = file.begin(); p < file.end();) {
+        string_view line = nextLine(p, file.end());
+        if (line.empty()) continue;
+        double w = 1.0;
+        size_t comma = line.rfind(',');
+        if (comma != string_view::npos &&
+            from_chars(line.data() + comma + 1, line.data() + line.size(), w).ptr == line.data() + line.size()) {
+            line = line.substr(0, comma);
+        } else {
+            w = 1.0;
         }
-        cout << "\n";
+        int index = getCityIndex(line);
+        if (index == -1) ++unknown;
+        else weight[index] = w;
     }
+    if (unknown > 0) cerr << "Warning: skipped " << unknown << " unknown cities in " << path << ".\n";
+    return true;
 }
 
-// Menu 8: Display all recorded data (cities, roads, budgets)
-void displayAllData() {
-    displayCities();
-    displayRoadsMatrix();
+// Choose which recorded roads to build with a budget: the selection linking
+// the most pairs of cities, or, given priority weights, touching the most
+// priority. Roads without a budget are not candidates. Better selections are
+// reported on stderr while the search runs; the best one is printed at the
+// end.
+void optimizeRoads(double budget, double seconds, const vector<double>& priority) {
+    vector<RoadGraph::Road> candidates;
+    roadGraph.forEachRoad([&](uint32_t a, uint32_t b, double cost) {
+        if (cost > 0 && cost <= budget) candidates.push_back({a, b, cost});
+    });
+    if (candidates.empty()) {
+        cout << "No road with a budget fits within " << fixed << setprecision(2) << budget << " Billion Frw.\n";
+        return;
+    }
+    bool cover = !priority.empty();
+    RoadSelector selector(move(candidates), cities.size(), priority);
+    cerr << "Searching " << selector.candidateCount() << " candidate roads for " << fixed << setprecision(1) << seconds
+         << " s on " << workerCount() << " threads...\n";
+    double lastReport = -1.0;
+    auto progress = [&](const RoadSelector::Selection& s, double elapsed) {
+        if (elapsed < lastReport + 0.25) return; // At most four lines a second
+        lastReport = elapsed;
+        cerr << fixed << setprecision(2) << "  [" << elapsed << " s] " << setprecision(cover ? 2 : 0) << s.score
+             << (cover ? " priority covered" : " linked pairs") << " with " << s.roads.size() << " roads for "
+             << setprecision(2) << s.cost << " Billion Frw\n";
+    };
+    RoadSelector::Selection best = selector.run(cover ? RoadSelector::CoverCities : RoadSelector::LinkPairs,
+                                                budget, seconds, progress);
+    sort(best.roads.begin(), best.roads.end(), [](const RoadGraph::Road& x, const RoadGraph::Road& y) {
+        return x.from != y.from ? x.from < y.from : x.to < y.to;
+    });
+    printRoadList(best.roads);
+    cout << "Selected " << best.roads.size() << " roads for " << fixed << setprecision(2) << best.cost << " of "
+         << budget << " Billion Frw, ";
+    if (cover) {
+        double total = 0.0;
+        for (double w : priority) total += w;
+        cout << "covering " << best.score << " of " << total << " priority.\n";
+    } else {
+        double live = cities.liveCount();
+        cout << "linking " << setprecision(0) << best.score << " of " << live * (live - 1) / 2 << " city pairs.\n";
+    }
+}
+
+// Menu 24: Choose the roads to build within a budget
+void chooseRoadsForBudget() {
+    ScopedTimer timer(Metric::Optimize);
+    double budget, seconds;
+    cout << "Enter the budget available (in Billion Frw): ";
+    while (!(cin >> budget) || budget <= 0) {
+        cout << "Invalid input. Please enter a positive number: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cout << "Enter the search time in seconds: ";
+    while (!(cin >> seconds) || seconds < 0) {
+        cout << "Invalid input. Please enter a non-negative number: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
+    string path;
+    cout << "Priority cities file (leave empty to link as many cities as possible): ";
+    getline(cin, path);
+    vector<double> priority;
+    if (!path.empty() && !readPriorities(path, priority)) return;
+    cout << "\nRoads to Build\n--------------\n";
+    optimizeRoads(budget, seconds, priority);
+}
+
+// List the cities whose name starts with text, then, up to limit lines in
+// all, the ones whose name is a few typos away from it
+void printNameMatches(string_view text, size_t limit) {
+    const NameIndex& names = searchableNames();
+    vector<uint32_t> starting;
+    size_t total = names.complete(text, limit, starting);
+    OutputBuffer out;
+    for (uint32_t id : starting) out.integer(id + 1).text(". ").text(cities[id]).ch('\n');
+    if (total > starting.size()) {
+        out.text("... and ").integer(total - starting.size()).text(" more starting with '").text(text).text("'\n");
+    }
+    size_t shown = starting.size();
+    if (shown < limit) {
+        for (const auto& match : names.similar(text, NameIndex::defaultEdits(text.size()), limit)) {
+            if (shown == limit) break;
+            if (find(starting.begin(), starting.end(), match.first) != starting.end()) continue;
+            out.integer(match.first + 1).text(". ").text(cities[match.first]);
+            out.text(" (").integer(match.second).text(match.second == 1 ? " typo)\n" : " typos)\n");
+            ++shown;
+        }
+    }
+    if (shown == 0) out.text("No city name starts with or is close to '").text(text).text("'.\n");
+}
+
+// Menu 25: Search cities by the beginning of their name, or a misspelling
+void searchCitiesByName() {
+    ScopedTimer timer(Metric::SearchName);
+    string text;
+    cout << "Enter the beginning of a city name, or a name to look up: ";
+    getline(cin, text);
+    printNameMatches(text, 20);
+}
 
+// Compute the all-pairs table, reporting failures instead of aborting.
+// Returns false if there are no cities or the table does not fit in memory.
+bool computeAllPairs(AllPairsBudgets& table) {
     if (cities.empty()) {
-        cout << "No cities to display budgets for.\n";
-        return;
+        cout << "No cities recorded yet.\n";
+        return false;
     }
-    cout << "\nBudgets Adjacency Matrix\n------------------------\n";
-    // Print header (city names)
-    cout << setw(15) << ""; // Space for row headers
-    for (const auto& city : cities) {
-        cout << setw(7) << left << city.substr(0, 5); // Abbreviate city names
+    roadGraph.compact();
+    try {
+        table.compute(roadGraph);
+    } catch (const bad_alloc&) {
+        cerr << "Error: the table for " << cities.size() << " cities needs "
+             << AllPairsBudgets::bytesFor(cities.size()) / (1 << 20) << " MB, which is not available.\n";
+        return false;
     }
-    cout << "\n";
+    return true;
+}
+
+// Menu 11: Cheapest budget between every pair of cities
+void displayAllPairsBudgets() {
+    ScopedTimer timer(Metric::AllPairs);
+    AllPairsBudgets table;
+    if (!computeAllPairs(table)) return;
 
-    for (size_t i = 0; i < budgetMatrix.size(); ++i) {
-        cout << setw(15) << left << cities[i];
-        for (size_t j = 0; j < budgetMatrix[i].size(); ++j) {
-            cout << setw(7) << fixed << setprecision(1) << budgetMatrix[i][j];
+    if (cities.size() <= 30) { // Larger tables are only exported
+        cout << "\nCheapest Route Budgets Between All Cities\n-----------------------------------------\n";
+        cout << setw(15) << ""; // Space for row headers
+        for (uint32_t i = 0; i < cities.size(); ++i) {
+            if (cities.alive(i)) cout << setw(7) << left << cities[i].substr(0, 5); // Abbreviate city names
         }
         cout << "\n";
+        for (uint32_t i = 0; i < cities.size(); ++i) {
+            if (!cities.alive(i)) continue;
+            cout << setw(15) << left << cities[i];
+            for (uint32_t j = 0; j < cities.size(); ++j) {
+                if (!cities.alive(j)) continue;
+                double budget = table.budget(i, j);
+                if (budget == numeric_limits<double>::infinity()) cout << setw(7) << "-"; // Unreachable
+                else cout << setw(7) << fixed << setprecision(1) << budget;
+            }
+            cout << "\n";
+        }
+    }
+    if (table.exportBinary(kAllPairsPath)) {
+        cout << "Table saved to " << kAllPairsPath << ".\n";
+    } else {
+        cerr << "Error: Could not write " << kAllPairsPath << ".\n";
     }
 }
 
-// --- Main Menu and Application Logic ---
-void displayMainMenu() {
-    cout << "\nROADS-BUDGET-PLAN-CONSOLE-APPLICATION\n";
-    cout << "--------------------------------------\n";
-    cout << "1. Add new City(ies)\n";
-    cout << "2. Add roads between cities\n";
-    cout << "3. Add the budget for roads\n";
-    cout << "4. Edit city\n";
-    cout << "5. Search for a city using index\n";
-    cout << "6. Display cities\n";
-    cout << "7. Display roads\n";
-    cout << "8. Display recorded data on console\n";
-    cout << "9. Exit the application\n";
-    cout << "Enter your choice: ";
+// Menu 12: Check whether two cities are linked by any chain of roads
+void checkCitiesLinked() {
+    ScopedTimer timer(Metric::Linked);
+    string city1Name, city2Name;
+    cout << "Enter the name of the first City: ";
+    getline(cin, city1Name);
+    cout << "Enter the name of the second City: ";
+    getline(cin, city2Name);
+
+    int idx1 = resolveCity(city1Name);
+    int idx2 = resolveCity(city2Name);
+    if (idx1 == -1 || idx2 == -1) {
+        cout << "Error: One or both cities not found.\n";
+        suggestCity(city1Name);
+        suggestCity(city2Name);
+        return;
+    }
+    ConnectivityIndex& groups = linkedGroups();
+    if (groups.connected(idx1, idx2)) {
+        cout << city1Name << " and " << city2Name << " are linked by roads (group of "
+             << groups.groupSize(idx1) << " cities).\n";
+    } else {
+        cout << city1Name << " and " << city2Name << " are not linked by any roads.\n";
+    }
 }
 
-int main() {
-    int choice;
-    do {
-        displayMainMenu();
-        if (!(cin >> choice)) { // Input validation for menu choice
-            cout << "Invalid input. Please enter a number.\n";
-            cin.clear(); // Clear error flags
-            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Discard invalid input
-            continue; // Go back to menu
+// Menu 13: Display the groups of cities linked by roads
+void displayComponents() {
+    ScopedTimer timer(Metric::Components);
+    if (cities.liveCount() == 0) {
+        cout << "No cities recorded yet.\n";
+        return;
+    }
+    const size_t kGroupsShown = 50, kNamesShown = 10;
+    ConnectivityIndex& linked = linkedGroups();
+    vector<ConnectivityIndex::Component> groups = linked.components();
+    groups.erase(remove_if(groups.begin(), groups.end(), // Deleted cities are groups of their own
+                           [](const ConnectivityIndex::Component& g) { return !cities.alive(g.representative); }),
+                 groups.end());
+    size_t isolated = 0;
+    for (const auto& g : groups) isolated += g.size == 1;
+
+    // One pass over the cities collects the first names of each listed group
+    size_t shown = min(groups.size(), kGroupsShown);
+    vector<int> slotOfGroup(cities.size(), -1);
+    for (size_t i = 0; i < shown; ++i) slotOfGroup[linked.groupOf(groups[i].representative)] = i;
+    vector<vector<uint32_t>> names(shown);
+    for (uint32_t v = 0; v < cities.size(); ++v) {
+        int slot = slotOfGroup[linked.groupOf(v)];
+        if (slot != -1 && names[slot].size() < kNamesShown) names[slot].push_back(v);
+    }
+
+    cout << "\nConnected Groups of Cities\n--------------------------\n";
+    cout << groups.size() << " groups, " << isolated << " cities without roads.\n";
+    for (size_t i = 0; i < shown; ++i) {
+        cout << i + 1 << ". " << groups[i].size << " cities: ";
+        for (size_t k = 0; k < names[i].size(); ++k) {
+            cout << (k ? ", " : "") << cities[names[i][k]];
         }
-        cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer after number input
+        if (groups[i].size > names[i].size()) cout << ", ... and " << groups[i].size - names[i].size() << " more";
+        cout << "\n";
+    }
+    if (groups.size() > shown) cout << "... and " << groups.size() - shown << " more groups.\n";
+}
 
-        switch (choice) {
-            case 1: addNewCities(); break;
-            case 2: addRoads(); break;
-            case 3: addBudgetForRoads(); break;
-            case 4: editCity(); break;
-            case 5: searchCityByIndex(); break;
-            case 6: displayCities(); break;
-            case 7: displayRoadsMatrix(); break;
-            case 8: displayAllData(); break;
-            case 9: cout << "Exiting application. Goodbye!\n"; break;
-            default: cout << "Invalid choice. Please try again.\n"; break;
+// Budget statistics, histogram and the top cities by budget and by roads
+void printBudgetAnalytics(size_t top) {
+    ScopedTimer timer(Metric::Analytics);
+    roadGraph.compact(); // Analytics read the CSR arrays only
+    BudgetStats stats = budgetStats(roadGraph);
+    CityRollup rollup = cityRollup(roadGraph);
+
+    OutputBuffer out;
+    out.text("\nBudget Statistics\n-----------------\n");
+    out.text("Roads: ").integer(stats.roads).text(" (").integer(stats.unbudgeted).text(" without a budget)\n");
+    if (stats.roads > 0) {
+        out.text("Total budget: ").fixed(stats.total, 2).text(" Billion Frw\n");
+        out.text("Min / mean / max: ").fixed(stats.min, 2).text(" / ").fixed(stats.mean, 2);
+        out.text(" / ").fixed(stats.max, 2).ch('\n');
+        out.text("\nBudget range            Roads\n");
+        for (const BudgetHistogramBin& bin : stats.histogram) {
+            char range[64];
+            size_t n = OutputBuffer::formatFixed(range, bin.lower, 2);
+            if (bin.upper > 0) {
+                range[n++] = ' ';
+                range[n++] = '-';
+                range[n++] = ' ';
+                n += OutputBuffer::formatFixed(range + n, bin.upper, 2);
+            }
+            out.field(string_view(range, n), 24).integer(bin.roads).ch('\n');
         }
-    } while (choice != 9);
+    }
+    uint32_t isolated = rollup.isolated - cities.deletedCount(); // Deleted cities have no roads either
+    out.text("\nCities: ").integer(cities.liveCount()).text(" (").integer(isolated).text(" without roads), ");
+    out.text("max roads per city: ").integer(rollup.maxDegree).ch('\n');
+    if (stats.roads == 0) return;
+
+    auto liveTop = [&](const auto& values) { // Deleted cities can only tie at zero; drop them
+        vector<uint32_t> order = topIndices(values, top + cities.deletedCount());
+        order.erase(remove_if(order.begin(), order.end(), [](uint32_t i) { return !cities.alive(i); }), order.end());
+        if (order.size() > top) order.resize(top);
+        return order;
+    };
+    out.text("\nCities with the largest road budgets\n");
+    vector<uint32_t> order = liveTop(rollup.budget);
+    for (size_t i = 0; i < order.size(); ++i) {
+        out.integer(i + 1).text(". ").text(cities[order[i]]).ch(' ').fixed(rollup.budget[order[i]], 2);
+        out.text(" (").integer(rollup.degree[order[i]]).text(" roads)\n");
+    }
+    out.text("\nCities with the most roads\n");
+    order = liveTop(rollup.degree);
+    for (size_t i = 0; i < order.size(); ++i) {
+        out.integer(i + 1).text(". ").text(cities[order[i]]).ch(' ').integer(rollup.degree[order[i]]);
+        out.text(" roads (").fixed(rollup.budget[order[i]], 2).text(")\n");
+    }
+}
+
+// Menu 14: Display budget statistics
+void displayBudgetAnalytics() {
+    printBudgetAnalytics(10);
+}
+
+// Menu 15: Delete a city and every road touching it
+void deleteCityByName() {
+    ScopedTimer timer(Metric::DeleteCity);
+    string cityName;
+    cout << "Enter the name of the city to delete: ";
+    getline(cin, cityName);
+
+    int index = resolveCity(cityName);
+    if (index == -1) {
+        cout << "Error: City not found.\n";
+        suggestCity(cityName);
+        return;
+    }
+    size_t roads = 0;
+    roadGraph.forEachNeighbor(index, [&](uint32_t, double) { ++roads; });
+    deleteCity(index);
+    cout << "City '" << cityName << "' deleted with its " << roads << " roads.\n";
+    commitChanges(); // Journal the deletion
+}
+
+// Menu 16: Delete the road between two cities
+void deleteRoad() {
+    ScopedTimer timer(Metric::DeleteRoad);
+    string city1Name, city2Name;
+    cout << "Enter the name of the first City: ";
+    getline(cin, city1Name);
+    cout << "Enter the name of the second City: ";
+    getline(cin, city2Name);
+
+    int idx1 = resolveCity(city1Name);
+    int idx2 = resolveCity(city2Name);
+    if (idx1 == -1 || idx2 == -1 || idx1 == idx2) {
+        cout << "Error: One or both cities not found, or same city.\n";
+        suggestCity(city1Name);
+        suggestCity(city2Name);
+    } else if (removeRoadBetween(idx1, idx2)) {
+        cout << "Road between " << city1Name << " and " << city2Name << " deleted.\n";
+    } else {
+        cout << "Error: No road exists between " << city1Name << " and " << city2Name << ".\n";
+    }
+    commitChanges(); // Journal the removal
+}
+
+// List located cities as "<index>. <name> (<lat>, <lon>) <km> km" lines;
+// the distance is left out when it is NaN
+void printPlaces(const vector<pair<uint32_t, double>>& places) {
+    OutputBuffer out;
+    for (const auto& place : places) {
+        const GeoPoint& where = locations[place.first];
+        out.integer(place.first + 1).text(". ").text(cities[place.first]);
+        out.text(" (").fixed(where.lat, 4).text(", ").fixed(where.lon, 4).ch(')');
+        if (!isnan(place.second)) out.ch(' ').fixed(place.second, 1).text(" km");
+        out.ch('\n');
+    }
+    if (places.empty()) out.text("No located city matches.\n");
+}
+
+// Read "<lat> <lon>" in degrees until it is a valid location
+GeoPoint readLocation(const char* prompt) {
+    GeoPoint where;
+    cout << prompt;
+    while (!(cin >> where.lat >> where.lon) || !GeoPoint::valid(where.lat, where.lon)) {
+        cout << "Invalid input. Enter a latitude (-90 to 90) and a longitude (-180 to 180): ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
+    return where;
+}
+
+// Menu 22: Set the location of a city
+void setCityLocation() {
+    ScopedTimer timer(Metric::LocateCity);
+    string cityName;
+    cout << "Enter the name of the city: ";
+    getline(cin, cityName);
+
+    int index = resolveCity(cityName);
+    if (index == -1) {
+        cout << "Error: City not found.\n";
+        suggestCity(cityName);
+        return;
+    }
+    locateCity(index, readLocation("Enter its latitude and longitude in degrees (e.g. -1.9441 30.0619): "));
+    cout << "Location of " << cityName << " saved.\n";
+    commitChanges(); // Journal the location
+}
+
+// Menu 23: Find the located cities nearest to a point
+void findNearbyCities() {
+    ScopedTimer timer(Metric::Nearby);
+    GeoPoint where = readLocation("Enter a latitude and longitude in degrees: ");
+    int count;
+    cout << "How many cities? ";
+    while (!(cin >> count) || count <= 0) {
+        cout << "Invalid input. Please enter a positive number: ";
+        cin.clear();
+        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    }
+    cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer
+    printPlaces(placedCities().nearest(where, size_t(count)));
+}
+
+// Perform one edit replayed by undo, redo or a version switch, through the
+// same helpers as the menus so it is journaled like any other edit
+bool applyHistoryEdit(const Edit& e) {
+    if (e.kind == Edit::AddCity) {
+        if (!appendCity(e.a)) return false;
+        resizeRoadGraph();
+        return true;
+    }
+    int a = resolveCity(e.a);
+    if (a == -1) return false;
+    if (e.kind == Edit::DeleteCity) {
+        deleteCity(a);
+        return true;
+    }
+    if (e.kind == Edit::RenameCity) {
+        return resolveCity(e.b) == -1 && renameCity(a, e.b);
+    }
+    int b = resolveCity(e.b);
+    if (b == -1) return false;
+    switch (e.kind) {
+        case Edit::AddRoad:
+            if (!addRoadBetween(a, b)) return false;
+            if (e.budget == 0.0 || setRoadBudget(a, b, e.budget)) return true;
+            removeRoadBetween(a, b); // All or nothing, so a failed step can be reverted
+            return false;
+        case Edit::RemoveRoad: return removeRoadBetween(a, b);
+        case Edit::SetBudget: return setRoadBudget(a, b, e.budget);
+        default: return false;
+    }
+}
+
+// Report the outcome of an undo, redo or version switch and journal it
+void finishHistoryMove(bool ok, const char* done) {
+    if (ok) cout << done << "\n";
+    else cout << "Error: the network no longer matches its history; stopped at the last version reached.\n";
+    commitChanges();
+}
+
+// Menu 17: Undo the last edit
+void undoEdit() {
+    ScopedTimer timer(Metric::History);
+    history.endStep();
+    if (!history.canUndo()) {
+        cout << "Nothing to undo.\n";
+        return;
+    }
+    finishHistoryMove(history.undo(applyHistoryEdit), "Last edit undone.");
+}
+
+// Menu 18: Redo the last undone edit
+void redoEdit() {
+    ScopedTimer timer(Metric::History);
+    history.endStep();
+    if (!history.canRedo()) {
+        cout << "Nothing to redo.\n";
+        return;
+    }
+    finishHistoryMove(history.redo(applyHistoryEdit), "Edit redone.");
+}
+
+void listVersions() {
+    cout << "Saved versions:";
+    if (history.tags().empty()) cout << " none";
+    for (const auto& t : history.tags()) {
+        cout << "\n  " << t.first << (history.isCurrent(t.first) ? " (current)" : "");
+    }
+    cout << "\n";
+}
+
+// Read the name of a saved version; false if there is no such version
+bool readVersionName(const char* prompt, string& name) {
+    cout << prompt;
+    getline(cin, name);
+    if (history.hasTag(name)) return true;
+    cout << "Error: no version named '" << name << "'.\n";
+    return false;
+}
+
+// Menu 19: Give the current network a name to come back to
+void nameVersion() {
+    ScopedTimer timer(Metric::History);
+    string name;
+    cout << "Enter a name for this version: ";
+    getline(cin, name);
+    if (name.empty()) {
+        cout << "Error: the name cannot be empty.\n";
+    } else if (!history.tag(name)) {
+        cout << "Error: a version named '" << name << "' already exists.\n";
+    } else {
+        cout << "Version '" << name << "' saved.\n";
+    }
+}
+
+// Menu 20: Switch the network to a saved version
+void switchVersion() {
+    ScopedTimer timer(Metric::History);
+    listVersions();
+    string name;
+    if (history.tags().empty() || !readVersionName("Enter the version to switch to: ", name)) return;
+    finishHistoryMove(history.checkout(name, applyHistoryEdit), ("Switched to version '" + name + "'.").c_str());
+}
+
+// Menu 21: List the edits between two saved versions and the budget change
+void compareVersions() {
+    ScopedTimer timer(Metric::History);
+    listVersions();
+    string from, to;
+    if (history.tags().size() < 2 || !readVersionName("Enter the first version: ", from) ||
+        !readVersionName("Enter the second version: ", to)) {
+        return;
+    }
+    vector<Edit> edits = history.diff(from, to);
+    OutputBuffer out;
+    out.text("\nChanges from '").text(from).text("' to '").text(to).text("'\n");
+    double change = 0.0;
+    for (const Edit& e : edits) {
+        switch (e.kind) {
+            case Edit::AddCity: out.text("+ city ").text(e.a); break;
+            case Edit::DeleteCity: out.text("- city ").text(e.a); break;
+            case Edit::RenameCity: out.text("~ city ").text(e.a).text(" renamed to ").text(e.b); break;
+            case Edit::AddRoad:
+                out.text("+ road ").text(e.a).ch('-').text(e.b).ch(' ').fixed(e.budget, 2);
+                change += e.budget;
+                break;
+            case Edit::RemoveRoad:
+                out.text("- road ").text(e.a).ch('-').text(e.b).ch(' ').fixed(e.budget, 2);
+                change -= e.budget;
+                break;
+            case Edit::SetBudget:
+                out.text("~ road ").text(e.a).ch('-').text(e.b).ch(' ').fixed(e.previous, 2);
+                out.text(" -> ").fixed(e.budget, 2);
+                change += e.budget - e.previous;
+                break;
+        }
+        out.ch('\n');
+    }
+    out.integer(edits.size()).text(" changes, total budget ").text(change < 0 ? "-" : "+");
+    out.fixed(change < 0 ? -change : change, 2).text(" Billion Frw.\n");
+}
+
+// --- Main Menu and Application Logic ---
+void displayMainMenu() {
+    cout << "\nROADS-BUDGET-PLAN-CONSOLE-APPLICATION\n";
+    cout << "--------------------------------------\n";
+    cout << "1. Add new City(ies)\n";
+    cout << "2. Add roads between cities\n";
+    cout << "3. Add the budget for roads\n";
+    cout << "4. Edit city\n";
+    cout << "5. Search for a city using index\n";
+    cout << "6. Display cities\n";
+    cout << "7. Display roads\n";
+    cout << "8. Display recorded data on console\n";
+    cout << "10. Plan the cheapest road network connecting all cities\n";
+    cout << "11. Cheapest budgets between all pairs of cities\n";
+    cout << "12. Check if two cities are linked by roads\n";
+    cout << "13. Display groups of connected cities\n";
+    cout << "14. Display budget statistics\n";
+    cout << "15. Delete a city\n";
+    cout << "16. Delete a road\n";
+    cout << "17. Undo the last edit\n";
+    cout << "18. Redo\n";
+    cout << "19. Save this version under a name\n";
+    cout << "20. Switch to a saved version\n";
+    cout << "21. Compare two saved versions\n";
+    cout << "22. Set the location of a city\n";
+    cout << "23. Find the cities nearest to a location\n";
+    cout << "24. Choose the roads to build within a budget\n";
+    cout << "25. Search cities by name\n";
+    cout << "26. Find the cheapest route between two cities\n";
+    cout << "9. Exit the application\n";
+    cout << "Enter your choice: ";
+}
+
+// Journal::replay() handler that applies nothing, so replay() just counts
+// the edits written against snapshot `base` (against any snapshot if 0)
+struct JournalCounter {
+    uint64_t base = 0;
+    bool startsFrom(uint64_t b) { return base == 0 || b == base; }
+    void addCity(uint32_t, string_view) {}
+    void renameCity(uint32_t, string_view) {}
+    void deleteCity(uint32_t) {}
+    void addRoad(uint32_t, uint32_t) {}
+    void removeRoad(uint32_t, uint32_t) {}
+    void setBudget(uint32_t, uint32_t, double) {}
+    void locateCity(uint32_t, double, double) {}
+    void loadRegion(uint32_t) {}
+    void homeRegion(uint32_t) {}
+};
+
+// Journal::replay() handler that re-applies the edits written against
+// `base`: the checksum of network.bin, or of network.regions for a region
+// session's journal. Records the loaded network already covers are no-ops.
+struct JournalReplay {
+    uint64_t base = 0;
+    bool stale = false;  // The journal names another base
+    bool failed = false; // A region it loaded could not be loaded again
+    bool startsFrom(uint64_t b) {
+        stale = b != base;
+        return !stale;
+    }
+    void addCity(uint32_t id, string_view name) {
+        if (id != cities.nextId()) return; // Already in the snapshot, or out of order
+        appendCity(name);
+        resizeRoadGraph();
+    }
+    void renameCity(uint32_t id, string_view name) {
+        if (cities.alive(id)) ::renameCity(id, name);
+    }
+    void deleteCity(uint32_t id) {
+        if (cities.alive(id)) ::deleteCity(id);
+    }
+    void addRoad(uint32_t a, uint32_t b) { addRoadBetween(a, b); }
+    void removeRoad(uint32_t a, uint32_t b) { removeRoadBetween(a, b); }
+    void setBudget(uint32_t a, uint32_t b, double budget) { roadGraph.setBudget(a, b, budget); }
+    void locateCity(uint32_t id, double lat, double lon) {
+        if (cities.alive(id)) ::locateCity(id, {lat, lon});
+    }
+    void loadRegion(uint32_t r) {
+        if (r >= regionLoaded.size()) failed = true;
+        else if (!regionLoaded[r] && !::loadRegion(r)) failed = true;
+    }
+    void homeRegion(uint32_t r) {
+        if (r < regionLoaded.size()) ::homeRegion = r;
+    }
+};
+
+// Edits journaled by a region session that did not finish, against the
+// network.regions open in index
+size_t unsavedRegionEdits(const RegionIndex& index) {
+    JournalCounter check{index.checksum()};
+    return Journal::replay(kRegionJournalPath, check);
+}
+
+// Load network.bin. Returns false if there is no usable snapshot; a damaged
+// one is set aside as network.bin.bad so the next checkpoint cannot clobber
+// it. If the journal holds edits made on top of the damaged snapshot, both
+// files are left as they are and blocked is set: the session must not start.
+bool loadSnapshot(bool& blocked) {
+    SnapshotView view;
+    string error;
+    if (!view.open(kSnapshotPath, error)) {
+        JournalCounter any;
+        if (ifstream(kSnapshotPath).good() && Journal::replay(kJournalPath, any) > 0) {
+            cerr << "Error: " << kSnapshotPath << " is unusable (" << error << ") and " << kJournalPath
+                 << " holds edits made on top of it; both are left as they are. Restore " << kSnapshotPath
+                 << " from a backup, or move both away to start from cities.txt and roads.txt.\n";
+            blocked = true;
+        } else if (ifstream(kSnapshotPath).good()) {
+            string badPath = string(kSnapshotPath) + ".bad";
+            cerr << "Warning: " << kSnapshotPath << " is unusable (" << error << "); moved to " << badPath << ".\n";
+            replaceFile(kSnapshotPath, badPath);
+        }
+        return false;
+    }
+    snapshotBase = view.checksum(); // The journal must have been written against this snapshot
+    cities.reserve(view.cityCount());
+    for (uint32_t i = 0; i < view.cityCount(); ++i) {
+        cities.add(view.cityName(i)); // Index i, like the roads and locations that refer to it
+    }
+    for (size_t i = 0; i < view.deletedCount(); ++i) cities.remove(view.deleted()[i]); // Gaps from mid-session saves
+    resizeRoadGraph();
+    if (view.points()) {
+        locations.resize(view.cityCount());
+        for (uint32_t i = 0; i < view.cityCount(); ++i) locations[i] = {view.points()[i].lat, view.points()[i].lon};
+        spatialIndex.invalidate();
+    }
+    vector<RoadGraph::Road> roads(view.roadCount());
+    for (size_t i = 0; i < roads.size(); ++i) {
+        const SnapshotRoad& r = view.roads()[i];
+        roads[i] = {r.from, r.to, r.budget};
+    }
+    roadGraph.addRoadsBulk(roads);
+    return true;
+}
+
+// Load cities.txt and roads.txt (the text interchange format). Both files are
+// memory-mapped and parsed in place; roads are merged into the graph in bulk.
+// Returns false if either file could not be opened.
+bool loadTextFiles() {
+    MappedFile file;
+    bool citiesRead = file.open("cities.txt");
+    if (citiesRead) {
+        ParseStats stats = parseCitiesText(file.begin(), file.end(), [](string_view name, double lat, double lon) {
+            if (!appendCity(name)) return false; // Duplicate name
+            if (GeoPoint::valid(lat, lon)) locateCity(getCityIndex(name), {lat, lon});
+            return true;
+        });
+        if (stats.skipped > 0) cerr << "Warning: skipped " << stats.skipped << " malformed or duplicate lines in cities.txt.\n";
+        resizeRoadGraph();
+    }
+    bool roadsRead = file.open("roads.txt");
+    if (roadsRead) {
+        vector<RoadGraph::Road> roads;
+        roads.reserve(file.size() / 24); // Typical line is "12. Kigali-Huye 28.60"
+        ParseStats stats = parseRoadsText(file.begin(), file.end(), getCityIndex,
+            [&](int a, int b, double budget) { roads.push_back({uint32_t(a), uint32_t(b), budget}); });
+        if (stats.skipped > 0) cerr << "Warning: skipped " << stats.skipped << " unreadable roads in roads.txt.\n";
+        roadGraph.addRoadsBulk(roads);
+    }
+    return citiesRead && roadsRead;
+}
+
+// Load the network saved by a previous session: network.bin, or the text
+// files when there is no snapshot yet, then any journaled edits on top,
+// whose number goes to recoveredEdits. Returns false if the saved network
+// cannot be loaded without losing edits.
+bool loadSavedData(size_t& recoveredEdits) {
+    ScopedTimer timer(Metric::LoadNetwork);
+    bool blocked = false;
+    if (!loadSnapshot(blocked)) {
+        if (blocked) return false;
+        loadTextFiles();
+    }
+    connectivity.rebuild(roadGraph); // Bulk loads bypass the incremental updates
+
+    // Re-apply edits made after the last checkpoint. A journal written
+    // against another snapshot (a crash between writing network.bin and
+    // resetting the journal) is already in network.bin and is set aside.
+    // Journals from before the S line are replayed as they are.
+    JournalReplay handler{snapshotBase};
+    size_t replayed = Journal::replay(kJournalPath, handler);
+    if (replayed > 0) cout << "Recovered " << replayed << " journaled edits.\n";
+    JournalCounter any;
+    if (handler.stale && Journal::replay(kJournalPath, any) > 0) { // An empty one is simply restarted
+        string oldPath = string(kJournalPath) + ".old";
+        cerr << "Warning: " << kJournalPath << " predates " << kSnapshotPath << "; moved to " << oldPath << ".\n";
+        replaceFile(kJournalPath, oldPath);
+    }
+
+    if (cities.liveCount() > 0) {
+        cout << "Loaded " << cities.liveCount() << " cities and " << roadGraph.roadCount() << " roads.\n";
+    }
+    RegionIndex split;
+    string error;
+    if (split.open(kRegionIndexPath, error) && unsavedRegionEdits(split) > 0) {
+        cerr << "Warning: an --edit-region session did not finish; run --edit-region to save its edits, then "
+             << "--merge-regions to bring them into " << kSnapshotPath << ".\n";
+    } else if (split.isOpen() && split.source().edited) {
+        cerr << "Warning: edits made with --edit-region are not in " << kSnapshotPath
+             << " yet; run --merge-regions to bring them in.\n";
+    }
+    recoveredEdits = replayed;
+    return true;
+}
+
+// Non-interactive mode: --import-cities <file>
+int importCities(const string& path) {
+    vector<string> names;
+    vector<GeoPoint> where;
+    if (!readCityNames(path, names, where)) return 1;
+    vector<char> isNew;
+    int added = addCitiesBatch(names, &isNew);
+    for (size_t i = 0; i < names.size(); ++i) { // A skipped duplicate must not move the city already there
+        if (isNew[i] && where[i].known() && GeoPoint::valid(where[i].lat, where[i].lon)) {
+            locateCity(getCityIndex(names[i]), where[i]);
+        }
+    }
+    checkpoint(); // Write the batch to the snapshot once
+    cout << "Imported " << added << " cities (" << names.size() - added << " skipped).\n";
+    return 0;
+}
+
+// Non-interactive mode: --import-roads <file>, a road inventory in the
+// roads.txt layout or as "<CityA>,<CityB>,<budget>" CSV lines. The file is
+// cut at line boundaries into one chunk per thread; each thread resolves
+// names against the (read-only) city table into its own road buffer, and
+// the buffers are sorted and merged into the graph in parallel. The roads
+// skip the journal: one checkpoint writes them all to the snapshot.
+int importRoads(const string& path) {
+    ScopedTimer timer(Metric::ImportRoads);
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Error: Could not open " << path << " for reading.\n";
+        return 1;
+    }
+    const char* data = file.begin();
+    const size_t size = file.size();
+    const char* first = data;
+    bool roadsText = nextLine(first, file.end()) == "Nbr Road Budget";
+    auto lookup = [](string_view name) { return cities.find(name); };
+
+    auto start = chrono::steady_clock::now();
+    vector<vector<RoadGraph::Road>> parts(workerCount());
+    vector<ParseStats> stats(workerCount());
+    parallelFor(size, [&](size_t begin, size_t end, unsigned worker) {
+        // A chunk owns the lines that start inside it
+        auto lineStart = [&](size_t at) {
+            if (at == 0 || at >= size || data[at - 1] == '\n') return data + min(at, size);
+            const void* nl = memchr(data + at, '\n', size - at);
+            return nl ? static_cast<const char*>(nl) + 1 : data + size;
+        };
+        auto add = [&](int a, int b, double budget) { parts[worker].push_back({uint32_t(a), uint32_t(b), budget}); };
+        const char* p = lineStart(begin);
+        const char* stop = lineStart(end);
+        stats[worker] = roadsText ? parseRoadsText(p, stop, lookup, add) : parseRoadsCsv(p, stop, lookup, add);
+    }, size_t(1) << 20);
+    auto parsed = chrono::steady_clock::now();
+
+    size_t before = roadGraph.roadCount();
+    roadGraph.addRoadsBulk(parts);
+    connectivity.rebuild(roadGraph);
+    auto merged = chrono::steady_clock::now();
+    checkpoint();
+
+    ParseStats total;
+    for (const ParseStats& s : stats) {
+        total.parsed += s.parsed;
+        total.skipped += s.skipped;
+    }
+    auto ms = [](auto from, auto to) { return chrono::duration<double, milli>(to - from).count(); };
+    cout << "Imported " << roadGraph.roadCount() - before << " new roads from " << total.parsed << " lines ("
+         << total.skipped << " skipped).\n";
+    cerr << fixed << setprecision(1) << "Parsed " << size / 1e6 << " MB in " << ms(start, parsed) << " ms ("
+         << size / 1e3 / max(ms(start, parsed), 1e-3) << " MB/s, " << workerCount() << " threads), merged in "
+         << ms(parsed, merged) << " ms.\n";
+    return 0;
+}
+
+// Non-interactive mode: --routes <file>. Each line names a query pair as
+// "<CityA>-<CityB>"; answers go to stdout, one line per query:
+//     Kigali-Rusizi: 45.20 via Kigali -> Huye -> Rusizi
+int answerRouteQueries(const string& path) {
+    ScopedTimer timer(Metric::RouteBatch);
+    MappedFile file;
+    if (!file.open(path)) {
+        cerr << "Error: Could not open " << path << " for reading.\n";
+        return 1;
+    }
+    roadGraph.compact();
+    double rate = minBudgetPerKm(); // Once for the whole file
+    string out; // Whole report, written once
+    size_t queries = 0;
+    auto start = chrono::steady_clock::now();
+    for (const char* p = file.begin(); p < file.end();) {
+        string_view line = nextLine(p, file.end());
+        if (line.empty()) continue;
+        ++queries;
+        out.append(line.data(), line.size());
+        int a = -1, b = -1;
+        if (!splitCityPair(line, resolveCity, a, b)) {
+            out += ": unknown city\n";
+            continue;
+        }
+        RouteResult route;
+        if (linkedGroups().connected(a, b)) route = cheapestRoute(a, b, rate);
+        if (!route.found) {
+            out += ": no route\n";
+            continue;
+        }
+        char buf[32];
+        out += ": ";
+        out.append(buf, to_chars(buf, buf + sizeof buf, route.cost, chars_format::fixed, 2).ptr);
+        out += " via ";
+        for (size_t i = 0; i < route.path.size(); ++i) {
+            if (i) out += " -> ";
+            out += cities[route.path[i]];
+        }
+        out += '\n';
+    }
+    double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    cout << out;
+    cerr << "Answered " << queries << " route queries in " << fixed << setprecision(1) << micros / 1000
+         << " ms (" << (queries ? micros / queries : 0.0) << " us/query).\n";
+    return 0;
+}
+
+// Non-interactive mode: --plan [kruskal|boruvka]
+int planNetwork(const string& algorithm) {
+    ScopedTimer timer(Metric::Plan);
+    if (algorithm != "kruskal" && algorithm != "boruvka") {
+        cerr << "Error: unknown planning algorithm '" << algorithm << "' (use kruskal or boruvka).\n";
+        return 1;
+    }
+    roadGraph.compact();
+    auto start = chrono::steady_clock::now();
+    NetworkPlan plan = algorithm == "kruskal" ? planKruskal(roadGraph) : planBoruvka(roadGraph);
+    double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    printNetworkPlan(plan);
+    cerr << "Planned with " << algorithm << " in " << fixed << setprecision(1) << millis << " ms.\n";
+    return 0;
+}
+
+// Non-interactive mode: --optimize <budget> [seconds] [priorities] (see
+// optimizeRoads(); the search runs for 5 seconds by default)
+int optimizeBudget(int argc, char* argv[]) {
+    ScopedTimer timer(Metric::Optimize);
+    double budget = argc > 2 ? atof(argv[2]) : 0.0;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    if (budget <= 0 || seconds < 0) {
+        cerr << "Usage: --optimize <budget> [seconds] [priority cities file]\n";
+        return 1;
+    }
+    vector<double> priority;
+    if (argc > 4 && !readPriorities(argv[4], priority)) return 1;
+    optimizeRoads(budget, seconds, priority);
+    return 0;
+}
+
+// Non-interactive mode: --all-pairs <file> exports the all-pairs table
+int exportAllPairs(const string& path) {
+    ScopedTimer timer(Metric::AllPairs);
+    AllPairsBudgets table;
+    auto start = chrono::steady_clock::now();
+    if (!computeAllPairs(table)) return 1;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (!table.exportBinary(path)) {
+        cerr << "Error: Could not write " << path << ".\n";
+        return 1;
+    }
+    cerr << "Computed " << cities.size() << " x " << cities.size() << " budgets in " << fixed
+         << setprecision(1) << seconds << " s; saved to " << path << ".\n";
+    return 0;
+}
+
+// Apply one edit command (ADD_CITY, ADD_ROAD, SET_BUDGET, EDIT, DELETE_CITY,
+// DELETE_ROAD or LOCATE, as in --batch scripts). ADD_CITY does not grow the
+// road graph; callers call resizeRoadGraph() before the next road edit.
+// Returns false with a reason if the command is unknown or cannot be applied.
+bool applyEdit(string_view command, string_view arg, string& error) {
+    int a = -1, b = -1;
+    if (command == "ADD_CITY") {
+        if (arg.empty() || !appendCity(arg)) {
+            error = "empty or duplicate city";
+            return false;
+        }
+    } else if (command == "ADD_ROAD") {
+        if (!splitCityPair(arg, resolveCity, a, b)) {
+            error = "unknown city";
+            return false;
+        }
+        if (a == b || !addRoadBetween(a, b)) {
+            error = "same city or road already exists";
+            return false;
+        }
+    } else if (command == "SET_BUDGET") {
+        size_t lastSpace = arg.rfind(' ');
+        double budget = -1.0;
+        const char* numEnd = arg.data() + arg.size();
+        if (lastSpace == string_view::npos ||
+            from_chars(arg.data() + lastSpace + 1, numEnd, budget).ptr != numEnd || budget < 0) {
+            error = "missing or negative budget";
+            return false;
+        }
+        if (!splitCityPair(arg.substr(0, lastSpace), resolveCity, a, b)) {
+            error = "unknown city";
+            return false;
+        }
+        if (!setRoadBudget(a, b, budget)) {
+            error = "no road between these cities";
+            return false;
+        }
+    } else if (command == "EDIT") {
+        size_t nameStart = arg.find(' ');
+        uint32_t index = 0;
+        if (nameStart == string_view::npos || from_chars(arg.data(), arg.data() + nameStart, index).ptr != arg.data() + nameStart ||
+            index == 0 || nameStart + 1 == arg.size()) {
+            error = "expected EDIT <index> <new name>";
+            return false;
+        }
+        if (!cities.alive(index - 1)) {
+            error = index <= cities.size() ? "the city at this index was deleted" : "no city at this index";
+            return false;
+        }
+        if (!renameCity(index - 1, arg.substr(nameStart + 1))) {
+            error = "city already exists";
+            return false;
+        }
+    } else if (command == "DELETE_CITY") {
+        a = resolveCity(arg);
+        if (a == -1) {
+            error = "unknown city";
+            return false;
+        }
+        deleteCity(a);
+    } else if (command == "DELETE_ROAD") {
+        if (!splitCityPair(arg, resolveCity, a, b)) {
+            error = "unknown city";
+            return false;
+        }
+        if (!removeRoadBetween(a, b)) {
+            error = "no road between these cities";
+            return false;
+        }
+    } else if (command == "LOCATE") {
+        GeoPoint where;
+        string_view name = arg;
+        if (!splitLocation(name, where.lat, where.lon) || (where.known() && !GeoPoint::valid(where.lat, where.lon))) {
+            error = "expected LOCATE <name> <lat> <lon> in degrees";
+            return false;
+        }
+        a = resolveCity(name);
+        if (a == -1) {
+            error = "unknown city";
+            return false;
+        }
+        locateCity(a, where);
+    } else {
+        error = "unknown command";
+        return false;
+    }
+    return true;
+}
+
+// "<lat> <lon> [n]" of a NEAREST command; count keeps its value if n is left out
+bool parseNearest(string_view arg, GeoPoint& where, size_t& count) {
+    const char* p = arg.data();
+    const char* end = p + arg.size();
+    p = from_chars(p, end, where.lat).ptr;
+    if (p >= end || *p != ' ') return false;
+    p = from_chars(p + 1, end, where.lon).ptr;
+    if (p < end && (*p != ' ' || from_chars(p + 1, end, count).ptr != end)) return false;
+    return GeoPoint::valid(where.lat, where.lon);
+}
+
+// Non-interactive mode: --batch [file]. Streams commands from a file (or
+// stdin when no file or "-" is given), one per line:
+//     ADD_CITY <name>
+//     ADD_ROAD <CityA>-<CityB>
+//     SET_BUDGET <CityA>-<CityB> <budget>
+//     EDIT <index> <new name>
+//     DELETE_CITY <name>           the city and its roads
+//     DELETE_ROAD <CityA>-<CityB>
+//     LOCATE <name> <lat> <lon>    "- -" clears the location
+//     QUERY <CityA>-<CityB>        cheapest route, answered on stdout
+//     LINKED <CityA>-<CityB>       "yes" or "no" on stdout
+//     NEAREST <lat> <lon> [n]      the n (default 1) nearest located cities
+// Blank lines and lines starting with '#' are ignored. Nothing is journaled
+// while the batch runs; the network is saved once at the end.
+int runBatch(const string& path) {
+    ScopedTimer timer(Metric::Batch);
+    MappedFile file;
+    string input; // stdin has to be read into memory first
+    const char* p;
+    const char* end;
+    if (path.empty() || path == "-") {
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof chunk, stdin)) > 0) input.append(chunk, n);
+        p = input.data();
+        end = p + input.size();
+    } else {
+        if (!file.open(path)) {
+            cerr << "Error: Could not open " << path << " for reading.\n";
+            return 1;
+        }
+        p = file.begin();
+        end = file.end();
+    }
+
+    string out, errors, error; // Answers and diagnostics, written in large blocks
+    size_t lineNo = 0, applied = 0, failed = 0;
+    bool citiesAdded = false;
+    auto fail = [&](string_view why, string_view line) {
+        ++failed;
+        errors += "line " + to_string(lineNo) + ": ";
+        errors.append(why.data(), why.size());
+        errors += ": ";
+        errors.append(line.data(), line.size());
+        errors += '\n';
+    };
+    auto start = chrono::steady_clock::now();
+    while (p < end) {
+        string_view line = nextLine(p, end);
+        ++lineNo;
+        if (line.empty() || line[0] == '#') continue;
+        size_t space = line.find(' ');
+        string_view command = line.substr(0, space);
+        string_view arg = space == string_view::npos ? string_view() : line.substr(space + 1);
+
+        if (command != "ADD_CITY" && citiesAdded) { // Grow the graph once per run of ADD_CITY commands
+            resizeRoadGraph();
+            citiesAdded = false;
+        }
+        if (command == "NEAREST") {
+            GeoPoint where;
+            size_t count = 1;
+            if (!parseNearest(arg, where, count)) {
+                fail("expected NEAREST <lat> <lon> [n]", line);
+                continue;
+            }
+            auto found = placedCities().nearest(where, count);
+            if (found.empty()) out += "none";
+            for (size_t i = 0; i < found.size(); ++i) {
+                char buf[32];
+                if (i) out += ", ";
+                out += cities[found[i].first];
+                out += ' ';
+                out.append(buf, to_chars(buf, buf + sizeof buf, found[i].second, chars_format::fixed, 1).ptr);
+                out += " km";
+            }
+            out += '\n';
+        } else if (command == "QUERY" || command == "LINKED") {
+            int a = -1, b = -1;
+            if (!splitCityPair(arg, resolveCity, a, b)) {
+                fail("unknown city", line);
+                continue;
+            }
+            if (command == "LINKED") {
+                out += linkedGroups().connected(a, b) ? "yes\n" : "no\n";
+            } else {
+                RouteResult route;
+                if (linkedGroups().connected(a, b)) route = routePlanner.bidirectional(roadGraph, a, b);
+                if (!route.found) {
+                    out += "no route\n";
+                } else {
+                    char buf[32];
+                    out.append(buf, to_chars(buf, buf + sizeof buf, route.cost, chars_format::fixed, 2).ptr);
+                    for (size_t i = 0; i < route.path.size(); ++i) {
+                        out += i ? " -> " : " via ";
+                        out += cities[route.path[i]];
+                    }
+                    out += '\n';
+                }
+            }
+        } else if (!applyEdit(command, arg, error)) {
+            fail(error, line);
+            continue;
+        } else if (command == "ADD_CITY") {
+            citiesAdded = true;
+        }
+        ++applied;
+        if (out.size() > (1 << 20)) { // Keep memory bounded on long query streams
+            cout << out;
+            out.clear();
+        }
+    }
+    if (citiesAdded) resizeRoadGraph();
+    cout << out;
+    cerr << errors;
+    double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << "Applied " << applied << " commands (" << failed << " failed) in " << fixed << setprecision(1)
+         << millis << " ms.\n";
+
+    compactCityIds();              // The batch is over: nobody holds its indices any more
+    if (!saveSnapshot()) return 1; // Persist the whole batch once
+    remove(kJournalPath);          // Any recovered edits are in the snapshot now
+    return failed == 0 ? 0 : 2;
+}
+
+// Non-interactive mode: --analytics [top] prints budget statistics and the
+// top cities
+int printAnalytics(size_t top) {
+    auto start = chrono::steady_clock::now();
+    printBudgetAnalytics(top);
+    double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr << "Analysed " << roadGraph.roadCount() << " roads in " << fixed << setprecision(1) << millis << " ms.\n";
+    return 0;
+}
+
+// Start recording undo steps. The versions saved by the last session are
+// kept if they describe exactly the network that was loaded.
+void startHistory(size_t recoveredEdits) {
+    bool saved = ifstream(kHistoryPath).good();
+    if (saved && (recoveredEdits > 0 || !history.load(kHistoryPath, snapshotBase))) {
+        cerr << "Warning: " << kHistoryPath << " does not match the loaded network; saved versions are dropped.\n";
+    }
+    history.start();
+}
+
+// Fold this session's journal into network.bin (skipping the rewrite if
+// nothing changed since the snapshot was written), closing the gaps left by
+// deleted cities, and keep the versions
+void finishSession() {
+    if (cities.deletedCount() > 0) {
+        journal.commit(); // The records name the indices from before the renumbering
+        compactCityIds();
+        checkpoint();
+    } else if (journal.size() > 0 || !journal.isOpen() || !ifstream(kSnapshotPath).good()) {
+        checkpoint();
+    }
+    if (history.recording() && !history.save(kHistoryPath, snapshotBase)) {
+        cerr << "Error: Could not write " << kHistoryPath << ".\n";
+    }
+}
+
+// Non-interactive mode: --region <first> <last> summarizes the cities with
+// indices first..last as a dense subnetwork: roads inside the region, its
+// exact total budget and the cities with the most roads inside it
+int printRegion(long first, long last, size_t top) {
+    ScopedTimer timer(Metric::Region);
+    if (first < 1 || last < first || last > long(cities.size())) {
+        cerr << "Error: the region must be a range of indices between 1 and " << cities.size() << ".\n";
+        return 1;
+    }
+    vector<uint32_t> members;
+    for (uint32_t i = uint32_t(first - 1); i < uint32_t(last); ++i) {
+        if (cities.alive(i)) members.push_back(i);
+    }
+    roadGraph.compact();
+    DenseSubnetwork region;
+    auto start = chrono::steady_clock::now();
+    try {
+        region.build(roadGraph, members);
+    } catch (const bad_alloc&) {
+        cerr << "Error: a region of " << members.size() << " cities does not fit in memory.\n";
+        return 1;
+    }
+    vector<uint32_t> degree = region.degrees();
+    uint64_t cents = region.totalCents();
+    double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    OutputBuffer out;
+    out.text("Region ").integer(first).ch('-').integer(last).text(": ").integer(members.size()).text(" cities, ");
+    out.integer(region.roadCount()).text(" roads inside (");
+    out.fixed(region.pairCount() ? 100.0 * region.roadCount() / region.pairCount() : 0.0, 1).text("% of pairs)\n");
+    out.text("Total budget inside the region: ").integer(cents / 100).ch('.');
+    out.ch(char('0' + cents % 100 / 10)).ch(char('0' + cents % 10)).text(" Billion Frw\n");
+    out.text("Packed size: ").integer(region.bytes()).text(" bytes (int and double matrices: ");
+    out.integer(uint64_t(members.size()) * members.size() * (sizeof(int) + sizeof(double))).text(" bytes)\n");
+    if (region.roadCount() > 0) {
+        out.text("\nCities with the most roads inside the region\n");
+        vector<uint32_t> order = topIndices(degree, top);
+        for (size_t i = 0; i < order.size(); ++i) {
+            out.integer(i + 1).text(". ").text(cities[members[order[i]]]).ch(' ').integer(degree[order[i]]).text(" roads\n");
+        }
+    }
+    out.flush();
+    cerr << "Built and scanned the region in " << fixed << setprecision(1) << millis << " ms.\n";
+    return 0;
+}
+
+#ifndef _WIN32
+QueryServer* activeServer = nullptr; // For the signal handler
+
+extern "C" void stopActiveServer(int) {
+    if (activeServer) activeServer->stop();
+}
+
+// Copy the live network into an immutable snapshot for the query server
+NetworkSnapshot* buildNetworkSnapshot() {
+    roadGraph.compact(); // Readers only walk the CSR arrays
+    NetworkSnapshot* snapshot = new NetworkSnapshot;
+    snapshot->cities = cities;
+    snapshot->graph = roadGraph;
+    snapshot->group.resize(cities.size());
+    ConnectivityIndex& linked = linkedGroups();
+    for (uint32_t i = 0; i < cities.size(); ++i) snapshot->group[i] = linked.groupOf(i);
+    return snapshot;
+}
+
+// Non-interactive mode: --serve <socket> [workers] runs the query server
+// until SIGINT/SIGTERM, then checkpoints
+int serve(const string& socketPath, unsigned workers) {
+    QueryServer server(
+        workers,
+        [](string_view command, string_view arg, string& error) {
+            if (!applyEdit(command, arg, error)) return false;
+            if (command == "ADD_CITY") resizeRoadGraph();
+            return true;
+        },
+        buildNetworkSnapshot, commitChanges);
+    string error;
+    if (!server.listen(socketPath, error)) {
+        cerr << "Error: " << error << ".\n";
+        return 1;
+    }
+    activeServer = &server;
+    signal(SIGINT, stopActiveServer);
+    signal(SIGTERM, stopActiveServer);
+    signal(SIGPIPE, SIG_IGN); // Clients that hang up show up as write errors
+    cout << "Serving " << cities.size() << " cities on " << socketPath << " with " << workers
+         << " worker threads. Press Ctrl+C to stop.\n";
+    // A long-running server refreshes the metrics file every 10 seconds
+    mutex metricsMutex;
+    condition_variable metricsStop;
+    bool stopped = false;
+    thread metricsWriter([&] {
+        unique_lock<mutex> lock(metricsMutex);
+        while (!metricsPath.empty() && !metricsStop.wait_for(lock, chrono::seconds(10), [&] { return stopped; })) {
+            Metrics::instance().writePrometheus(metricsPath);
+        }
+    });
+    server.run();
+    {
+        lock_guard<mutex> lock(metricsMutex);
+        stopped = true;
+    }
+    metricsStop.notify_one();
+    metricsWriter.join();
+    activeServer = nullptr;
+    finishSession();
+    return 0;
+}
+#endif
+
+// Non-interactive mode: --export-text writes cities.txt and roads.txt
+int exportTextFiles() {
+    return saveCitiesToFile() && saveRoadsToFile() ? 0 : 1;
+}
+
+// Non-interactive mode: --import-text replaces the network with the contents
+// of cities.txt and roads.txt
+int importTextFiles() {
+    if (!loadTextFiles()) { // Keep the saved network rather than replace it with a partial one
+        cerr << "Error: Could not open cities.txt and roads.txt for reading; " << kSnapshotPath << " is unchanged.\n";
+        return 1;
+    }
+    cout << "Imported " << cities.size() << " cities and " << roadGraph.roadCount() << " roads.\n";
+    if (!saveSnapshot()) return 1;
+    remove(kJournalPath); // Edits to the replaced network no longer apply
+    return 0;
+}
+
+// Non-interactive modes: --nearest <lat> <lon> [n] (default 10), --within
+// <lat> <lon> <km> and --box <south> <west> <north> <east> list the located
+// cities nearest to a point, within a distance of it or inside a box
+int printNearby(const string& mode, int argc, char* argv[]) {
+    ScopedTimer timer(Metric::Nearby);
+    vector<double> v;
+    for (int i = 0; i < argc; ++i) {
+        const char* end = argv[i] + strlen(argv[i]);
+        double value = 0.0;
+        if (from_chars(argv[i], end, value).ptr != end) break;
+        v.push_back(value);
+    }
+    bool box = mode == "--box";
+    bool ok = v.size() == size_t(argc) && v.size() >= 2 && GeoPoint::valid(v[0], v[1]);
+    if (box) ok = ok && v.size() == 4 && GeoPoint::valid(v[2], v[3]) && v[0] <= v[2];
+    else if (mode == "--within") ok = ok && v.size() == 3 && v[2] >= 0;
+    else ok = ok && v.size() <= 3 && (v.size() == 2 || v[2] >= 1);
+    if (!ok) {
+        cerr << "Usage: --nearest <lat> <lon> [n] | --within <lat> <lon> <km> | --box <south> <west> <north> <east>\n";
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    const SpatialIndex& index = placedCities();
+    auto built = chrono::steady_clock::now();
+    vector<pair<uint32_t, double>> found;
+    if (box) {
+        for (uint32_t id : index.inBox(v[0], v[1], v[2], v[3])) found.push_back({id, NAN});
+    } else if (mode == "--within") {
+        found = index.within({v[0], v[1]}, v[2]);
+    } else {
+        found = index.nearest({v[0], v[1]}, v.size() > 2 ? size_t(v[2]) : 10);
+    }
+    auto done = chrono::steady_clock::now();
+    printPlaces(found);
+    auto ms = [](auto from, auto to) { return chrono::duration<double, milli>(to - from).count(); };
+    cerr << fixed << setprecision(3) << "Indexed " << index.size() << " located cities in " << ms(start, built)
+         << " ms; query took " << ms(built, done) << " ms.\n";
+    return 0;
+}
+
+// Non-interactive mode: --find-city <text> [n] lists up to n (default 20)
+// cities whose name starts with text, then the ones a few typos away from it
+int findCityByName(const string& text, size_t limit) {
+    ScopedTimer timer(Metric::SearchName);
+    auto start = chrono::steady_clock::now();
+    const NameIndex& names = searchableNames();
+    auto built = chrono::steady_clock::now();
+    printNameMatches(text, limit);
+    auto done = chrono::steady_clock::now();
+    auto ms = [](auto from, auto to) { return chrono::duration<double, milli>(to - from).count(); };
+    cerr << fixed << setprecision(3) << "Indexed " << names.size() << " city names in " << ms(start, built)
+         << " ms; search took " << ms(built, done) << " ms.\n";
+    return 0;
+}
+
+// Non-interactive mode: --hilbert-order renumbers the cities along a Hilbert
+// curve over their locations, so cities near each other on the map get
+// nearby indices and their roads sit close together in the road graph.
+// Cities without a location keep their order after the located ones.
+int hilbertOrder(size_t recoveredEdits) {
+    startHistory(recoveredEdits); // Versions refer to names, so they survive the renumbering
+    vector<uint32_t> newId = hilbertMapping(locations, cities.size(), [](uint32_t i) { return cities.alive(i); });
+    journal.commit();
+    cities.renumber(newId);
+    renumberCities(newId);
+    checkpoint();
+    finishSession();
+    cout << "Renumbered " << cities.size() << " cities in Hilbert order of their locations.\n";
+    return 0;
+}
+
+// The interactive menu, until 0 is chosen or the input ends
+void runMenu() {
+    int choice = -1; // Anything but 9 until a valid choice is read
+    do {
+        displayMainMenu();
+        {
+            ScopedTimer timer(Metric::MenuInput); // Reading and checking the choice only, not the action
+            if (!(cin >> choice)) { // Input validation for menu choice
+                if (cin.eof()) break; // Input closed: exit as if 9 was chosen
+                cout << "Invalid input. Please enter a number.\n";
+                cin.clear(); // Clear error flags
+                cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Discard invalid input
+                continue; // Go back to menu
+            }
+            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Clear buffer after number input
+        }
+
+        switch (choice) {
+            case 1: addNewCities(); break;
+            case 2: addRoads(); break;
+            case 3: addBudgetForRoads(); break;
+            case 4: editCity(); break;
+            case 5: searchCityByIndex(); break;
+            case 6: displayCities(); break;
+            case 7: displayRoadsMatrix(); break;
+            case 8: displayAllData(); break;
+            case 10: planCheapestNetwork(); break;
+            case 11: displayAllPairsBudgets(); break;
+            case 12: checkCitiesLinked(); break;
+            case 13: displayComponents(); break;
+            case 14: displayBudgetAnalytics(); break;
+            case 15: deleteCityByName(); break;
+            case 16: deleteRoad(); break;
+            case 17: undoEdit(); break;
+            case 18: redoEdit(); break;
+            case 19: nameVersion(); break;
+            case 20: switchVersion(); break;
+            case 21: compareVersions(); break;
+            case 22: setCityLocation(); break;
+            case 23: findNearbyCities(); break;
+            case 24: chooseRoadsForBudget(); break;
+            case 25: searchCitiesByName(); break;
+            case 26: findCheapestRoute(); break;
+            case 9: cout << "Exiting application. Goodbye!\n"; break;
+            default: cout << "Invalid choice. Please try again.\n"; break;
+        }
+    } while (choice != 9);
+}
+
+// Write the shard of every region r with members[r] listed (the city
+// indices of the region in shard order) to a temporary file, fill in its
+// table entry and name directory entries, and collect the roads from it to
+// other listed regions (every road of a listed city must lead to one). Then
+// write network.regions and put the new files in place, shards first.
+bool saveRegionFiles(const vector<vector<uint32_t>>& members, vector<RegionEntry>& table,
+                     vector<BoundaryRoad>& boundary, vector<RegionName>& names, RegionSource source) {
+    ScopedTimer timer(Metric::SaveRegions);
+    vector<uint32_t> regionOf(cities.size(), Partition::kNoRegion), position(cities.size(), 0);
+    for (uint32_t r = 0; r < members.size(); ++r) {
+        for (uint32_t k = 0; k < members[r].size(); ++k) {
+            regionOf[members[r][k]] = r;
+            position[members[r][k]] = k;
+        }
+    }
+    roadGraph.compact();
+    vector<uint32_t> written;
+    for (uint32_t r = 0; r < members.size(); ++r) {
+        if (members[r].empty() && !(regionLoaded.empty() || regionLoaded[r])) continue;
+        const vector<uint32_t>& ids = members[r];
+        RoadGraph shard;
+        shard.resize(uint32_t(ids.size()));
+        vector<RoadGraph::Road> roads;
+        vector<GeoPoint> where(ids.size());
+        for (uint32_t k = 0; k < ids.size(); ++k) {
+            uint32_t id = ids[k];
+            names.push_back({regionNameHash(cities[id]), r, k});
+            if (id < locations.size()) where[k] = locations[id];
+            roadGraph.forEachNeighbor(id, [&](uint32_t v, double budget) {
+                if (regionOf[v] == r) {
+                    if (id < v) roads.push_back({k, position[v], budget});
+                } else if (regionOf[v] != Partition::kNoRegion && r < regionOf[v]) {
+                    boundary.push_back({r, k, regionOf[v], position[v], budget});
+                }
+            });
+        }
+        shard.addRoadsBulk(roads);
+        RegionEntry& entry = table[r];
+        entry.cities = uint32_t(ids.size());
+        entry.roads = uint32_t(shard.roadCount());
+        string tmpPath = regionPath(r) + ".tmp";
+        if (!writeSnapshot(tmpPath, entry.cities, [&](uint32_t k) { return cities[ids[k]]; }, shard, {},
+                           &entry.checksum, where)) {
+            cerr << "Error: Could not write " << tmpPath << ".\n";
+            return false;
+        }
+        written.push_back(r);
+    }
+    string indexTmp = string(kRegionIndexPath) + ".tmp";
+    if (!writeRegionIndex(indexTmp, table, boundary, names, source)) {
+        cerr << "Error: Could not write " << indexTmp << ".\n";
+        return false;
+    }
+    regionIndex.close(); // The mapping must go before its file is replaced
+    for (uint32_t r : written) {
+        if (!replaceFile(regionPath(r) + ".tmp", regionPath(r))) return false;
+    }
+    return replaceFile(indexTmp, kRegionIndexPath);
+}
+
+// Open network.regions for a region session or a merge, reporting failures
+bool openRegionIndex() {
+    string error;
+    if (!regionIndex.open(kRegionIndexPath, error)) {
+        cerr << "Error: " << kRegionIndexPath << " is unusable (" << error << "); run --split-regions <count> first.\n";
+        return false;
+    }
+    regionCities.assign(regionIndex.regionCount(), {});
+    regionLoaded.assign(regionIndex.regionCount(), 0);
+    return true;
+}
+
+// Non-interactive mode: --split-regions <count> splits the network into
+// count regions with few roads between them and writes each one to its own
+// shard for --edit-region. network.bin itself is left as it is.
+int splitRegions(uint32_t count, size_t recoveredEdits) {
+    RegionIndex previous;
+    string error;
+    if (previous.open(kRegionIndexPath, error) && unsavedRegionEdits(previous) > 0) {
+        cerr << "Error: an --edit-region session did not finish; run --edit-region to save its edits, then "
+             << "--merge-regions.\n";
+        return 1;
+    }
+    if (previous.isOpen() && previous.source().edited) {
+        cerr << "Error: the regions hold edits that are not in " << kSnapshotPath
+             << " yet; run --merge-regions first.\n";
+        return 1;
+    }
+    previous.close();
+    startHistory(recoveredEdits);
+    finishSession(); // network.bin must hold everything, with no gaps in the indices
+    if (cities.liveCount() == 0) {
+        cout << "No cities recorded yet.\n";
+        return 1;
+    }
+    count = min(count, cities.liveCount());
+
+    auto start = chrono::steady_clock::now();
+    Partition split = partitionCities(roadGraph, count, [](uint32_t i) { return cities.alive(i); });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    vector<vector<uint32_t>> members(count);
+    for (uint32_t i = 0; i < cities.size(); ++i) {
+        if (split.regionOf[i] != Partition::kNoRegion) members[split.regionOf[i]].push_back(i);
+    }
+    vector<RegionEntry> table(count);
+    vector<BoundaryRoad> boundary;
+    vector<RegionName> names;
+    if (!saveRegionFiles(members, table, boundary, names, {snapshotBase, 0})) return 1;
+    for (uint32_t r = count; remove(regionPath(r).c_str()) == 0; ++r) {} // Shards of an earlier, larger split
+
+    vector<size_t> leaving(count, 0);
+    for (const BoundaryRoad& b : boundary) {
+        ++leaving[b.fromRegion];
+        ++leaving[b.toRegion];
+    }
+    OutputBuffer out;
+    for (uint32_t r = 0; r < count; ++r) {
+        uint32_t hub = members[r].front(); // The city with the most roads names the region
+        size_t most = 0;
+        for (uint32_t id : members[r]) {
+            size_t roads = 0;
+            roadGraph.forEachNeighbor(id, [&](uint32_t, double) { ++roads; });
+            if (roads > most) {
+                hub = id;
+                most = roads;
+            }
+        }
+        out.text("Region ").integer(r + 1).text(": ").integer(table[r].cities).text(" cities, ");
+        out.integer(table[r].roads).text(" roads, ").integer(leaving[r]).text(" roads to other regions (around ");
+        out.text(cities[hub]).text(")\n");
+    }
+    out.integer(split.cutRoads).text(" of ").integer(roadGraph.roadCount()).text(" roads run between regions.\n");
+    out.flush();
+    cerr << fixed << setprecision(2) << "Partitioned in " << seconds << " s.\n";
+    return 0;
+}
+
+// Non-interactive mode: --edit-region <region number or city name> runs the
+// menu on one region of a split network. Only that region is loaded at
+// first; another region is loaded when one of its cities is named. Cities
+// added join the first region. Edits go to network.regions.journal as they
+// are made; on exit the loaded regions are written back to their shards and
+// the journal is removed. A session that did not exit cleanly is replayed
+// from its journal and goes on where it stopped, on the region it started
+// with.
+int editRegion(const string& which) {
+    if (!openRegionIndex()) return 1;
+    JournalReplay replay{regionIndex.checksum()};
+    size_t recovered = Journal::replay(kRegionJournalPath, replay);
+    if (replay.failed) {
+        cerr << "Error: " << kRegionJournalPath << " could not be replayed; it is left as it is.\n";
+        return 1;
+    }
+    JournalCounter any;
+    if (replay.stale && Journal::replay(kRegionJournalPath, any) > 0) { // Saved, but not removed yet
+        string oldPath = string(kRegionJournalPath) + ".old";
+        cerr << "Warning: " << kRegionJournalPath << " predates " << kRegionIndexPath << "; moved to " << oldPath
+             << ".\n";
+        replaceFile(kRegionJournalPath, oldPath);
+    }
+    bool resumed = find(regionLoaded.begin(), regionLoaded.end(), 1) != regionLoaded.end();
+    if (!journal.open(kRegionJournalPath, regionIndex.checksum())) {
+        cerr << "Warning: Could not open " << kRegionJournalPath << "; edits will only be saved on exit.\n";
+    } else if (!journal.basedOn(regionIndex.checksum())) {
+        journal.reset(regionIndex.checksum()); // Only the S line of an older session was left
+    }
+    if (resumed) {
+        cout << "Resuming the session on region " << homeRegion + 1 << " that did not exit cleanly (" << recovered
+             << " journaled edits recovered).\n";
+    }
+    auto fail = [&] { // A new session leaves no journal behind; a resumed one keeps its edits
+        if (!resumed) {
+            journal.close();
+            remove(kRegionJournalPath);
+        }
+        return 1;
+    };
+
+    char* end = nullptr;
+    long number = strtol(which.c_str(), &end, 10);
+    if (!which.empty() && *end == '\0') {
+        if (number < 1 || number > long(regionIndex.regionCount())) {
+            cerr << "Error: the region number must be between 1 and " << regionIndex.regionCount() << ".\n";
+            return fail();
+        }
+        if (!resumed) homeRegion = uint32_t(number - 1);
+        if (!regionLoaded[number - 1] && !loadRegion(uint32_t(number - 1))) return fail();
+    } else {
+        loadRegionsNamed(which);
+        int index = getCityIndex(which);
+        if (index == -1) {
+            cerr << "Error: no region holds a city named '" << which << "'.\n";
+            return fail();
+        }
+        if (!resumed) homeRegion = cityOrigin[index].first;
+    }
+    journal.logHomeRegion(homeRegion);
+    journal.commit();
+    size_t leaving = 0;
+    for (size_t i = 0; i < regionIndex.boundaryCount(); ++i) {
+        const BoundaryRoad& b = regionIndex.boundary()[i];
+        leaving += b.fromRegion == homeRegion || b.toRegion == homeRegion;
+    }
+    cout << "Editing region " << homeRegion + 1 << " of " << regionIndex.regionCount() << ": " << cities.liveCount()
+         << " cities and " << roadGraph.roadCount() << " roads loaded; " << leaving
+         << " roads lead to other regions, which load when one of their cities is named.\n";
+
+    history.start(); // Undo works within the session; versions are not kept
+    runMenu();
+    journal.commit();
+    if (recovered == 0 && journal.edits() == 0) { // Nothing edited
+        journal.close();
+        remove(kRegionJournalPath);
+        return 0;
+    }
+
+    const uint32_t count = regionIndex.regionCount();
+    vector<RegionEntry> table(count);
+    vector<BoundaryRoad> boundary;
+    vector<RegionName> names;
+    for (uint32_t r = 0; r < count; ++r) table[r] = regionIndex.region(r);
+    vector<vector<uint32_t>> members(count);
+    vector<uint32_t> position(cities.size(), 0);
+    for (uint32_t r = 0; r < count; ++r) {
+        for (uint32_t pos = 0; r < regionCities.size() && pos < regionCities[r].size(); ++pos) {
+            uint32_t id = regionMember(r, pos);
+            if (id == CityTable::kRemoved) continue;
+            position[id] = uint32_t(members[r].size());
+            members[r].push_back(id);
+        }
+    }
+    for (uint32_t id = 0; id < cities.size(); ++id) { // Cities added in this session
+        if (cities.alive(id) && (id >= cityOrigin.size() || cityOrigin[id].first == Partition::kNoRegion)) {
+            members[homeRegion].push_back(id);
+        }
+    }
+    // Roads from a loaded region to one that is not stay as the index has
+    // them, with the loaded end at its new position; so do the regions
+    // that were not loaded
+    for (size_t i = 0; i < regionIndex.boundaryCount(); ++i) {
+        BoundaryRoad b = regionIndex.boundary()[i];
+        if (regionLoaded[b.fromRegion] && regionLoaded[b.toRegion]) continue; // In memory
+        if (regionLoaded[b.fromRegion]) {
+            uint32_t id = regionMember(b.fromRegion, b.fromCity);
+            if (id == CityTable::kRemoved) continue;
+            b.fromCity = position[id];
+        } else if (regionLoaded[b.toRegion]) {
+            uint32_t id = regionMember(b.toRegion, b.toCity);
+            if (id == CityTable::kRemoved) continue;
+            b.toCity = position[id];
+        }
+        boundary.push_back(b);
+    }
+    for (size_t i = 0; i < regionIndex.nameCount(); ++i) {
+        if (!regionLoaded[regionIndex.names()[i].region]) names.push_back(regionIndex.names()[i]);
+    }
+    RegionSource source = regionIndex.source();
+    source.edited = 1;
+    for (uint32_t r = 0; r < count; ++r) {
+        if (!regionLoaded[r]) members[r].clear();
+    }
+    if (!saveRegionFiles(members, table, boundary, names, source)) return 1; // The journal keeps the edits
+    journal.close();
+    remove(kRegionJournalPath); // Now in the shards
+    cout << "Regions saved to their shards; run --merge-regions to bring the edits into " << kSnapshotPath << ".\n";
+    return 0;
+}
+
+// Non-interactive mode: --merge-regions rebuilds network.bin from the
+// regions once they have been edited with --edit-region
+int mergeRegions() {
+    if (!openRegionIndex()) return 1;
+    if (unsavedRegionEdits(regionIndex) > 0) {
+        cerr << "Error: an --edit-region session did not finish; run --edit-region to save its edits first.\n";
+        return 1;
+    }
+    RegionSource source = regionIndex.source();
+    if (!source.edited) {
+        cout << kSnapshotPath << " already holds every region edit.\n";
+        return 0;
+    }
+    {
+        SnapshotView current;
+        string error;
+        if (current.open(kSnapshotPath, error) && current.checksum() != source.snapshot) {
+            cerr << "Error: " << kSnapshotPath << " was changed after the split, so the region edits cannot be "
+                 << "merged into it; move it away to rebuild it from the regions alone.\n";
+            return 1;
+        }
+    }
+    JournalCounter check{source.snapshot}; // Edits to the network.bin the regions came from
+    if (Journal::replay(kJournalPath, check) > 0) {
+        cerr << "Error: " << kJournalPath << " holds edits made after the split; they would be lost.\n";
+        return 1;
+    }
+
+    for (uint32_t r = 0; r < regionIndex.regionCount(); ++r) {
+        if (!loadRegion(r)) return 1;
+    }
+    vector<RegionEntry> table(regionIndex.regionCount());
+    for (uint32_t r = 0; r < table.size(); ++r) table[r] = regionIndex.region(r);
+    vector<BoundaryRoad> boundary(regionIndex.boundary(), regionIndex.boundary() + regionIndex.boundaryCount());
+    vector<RegionName> names(regionIndex.names(), regionIndex.names() + regionIndex.nameCount());
+    regionIndex.close(); // Back to a whole-network session: names no longer load regions
+    if (!saveSnapshot()) return 1;
+    remove(kJournalPath); // Written against the network.bin just replaced
+    string indexTmp = string(kRegionIndexPath) + ".tmp";
+    if (!writeRegionIndex(indexTmp, table, boundary, names, {snapshotBase, 0}) ||
+        !replaceFile(indexTmp, kRegionIndexPath)) {
+        cerr << "Error: Could not update " << kRegionIndexPath << ".\n";
+        return 1;
+    }
+    cout << "Merged " << table.size() << " regions into " << kSnapshotPath << ": " << cities.liveCount()
+         << " cities and " << roadGraph.roadCount() << " roads.\n";
+    return 0;
+}
+
+// Print and/or write the collected metrics (registered with atexit, so it
+// covers every exit path)
+void reportMetrics() {
+    cout.flush(); // Keep the report after the regular output
+    if (printStats) cerr << "\n" << Metrics::instance().report();
+    if (!metricsPath.empty() && !Metrics::instance().writePrometheus(metricsPath)) {
+        cerr << "Error: Could not write " << metricsPath << ".\n";
+    }
+}
+
+// --stats and --metrics <file> may appear anywhere on the command line. They
+// are taken out of argv so the modes below see their usual arguments.
+void parseMetricsOptions(int& argc, char* argv[]) {
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--stats") {
+            printStats = true;
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    if (printStats || !metricsPath.empty()) {
+        Metrics::instance().enable(); // Created before atexit, so it outlives reportMetrics
+        atexit(reportMetrics);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    parseMetricsOptions(argc, argv);
+    string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--import-text") {
+        return importTextFiles();
+    }
+
+    if (argc == 3 && mode == "--edit-region") {
+        return editRegion(argv[2]); // Works on the shards, not on network.bin
+    }
+    if (mode == "--merge-regions") {
+        return mergeRegions();
+    }
+
+    size_t recoveredEdits = 0;
+    if (!loadSavedData(recoveredEdits)) return 1; // Pick up where the last session left off
+    if (mode == "--export-text") {
+        return exportTextFiles();
+    }
+    if (mode == "--batch") {
+        return runBatch(argc > 2 ? argv[2] : "");
+    }
+    if (!journal.open(kJournalPath, snapshotBase)) {
+        cerr << "Warning: Could not open " << kJournalPath << "; edits will only be saved on exit.\n";
+    } else if (!journal.basedOn(snapshotBase)) {
+        checkpoint(); // A journal from before the S line: fold it in so new records get one
+    }
+
+    if (argc == 3 && mode == "--import-cities") {
+        return importCities(argv[2]);
+    }
+    if (argc == 3 && mode == "--import-roads") {
+        return importRoads(argv[2]);
+    }
+    if (argc == 3 && mode == "--split-regions") {
+        return splitRegions(uint32_t(max(1, atoi(argv[2]))), recoveredEdits);
+    }
+    if (mode == "--nearest" || mode == "--within" || mode == "--box") {
+        return printNearby(mode, argc - 2, argv + 2);
+    }
+    if (argc >= 3 && mode == "--find-city") {
+        return findCityByName(argv[2], argc > 3 ? size_t(max(1, atoi(argv[3]))) : 20);
+    }
+    if (mode == "--hilbert-order") {
+        return hilbertOrder(recoveredEdits);
+    }
+    if (argc == 3 && mode == "--routes") {
+        return answerRouteQueries(argv[2]);
+    }
+    if (argc == 3 && mode == "--all-pairs") {
+        return exportAllPairs(argv[2]);
+    }
+    if (mode == "--optimize") {
+        return optimizeBudget(argc, argv);
+    }
+    if (mode == "--plan") {
+        return planNetwork(argc > 2 ? argv[2] : "kruskal");
+    }
+    if (argc >= 4 && mode == "--region") {
+        return printRegion(atol(argv[2]), atol(argv[3]), argc > 4 ? size_t(max(0, atoi(argv[4]))) : 10);
+    }
+    if (mode == "--analytics") {
+        return printAnalytics(argc > 2 ? size_t(max(0, atoi(argv[2]))) : 10);
+    }
+#ifndef _WIN32
+    if (argc >= 3 && mode == "--serve") {
+        // No history: clients cannot undo, so their edits would only pile up
+        // as versions. Saved versions stay valid if nothing is edited.
+        return serve(argv[2], argc > 3 ? unsigned(max(1, atoi(argv[3]))) : workerCount());
+    }
+#endif
 
+    startHistory(recoveredEdits);
+    runMenu();
+    finishSession();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef> // For size_t
+#include <cstdio>  // For the fopen fallback
+#include <string>  // For file paths
+#include <vector>  // For the read-into-memory fallback
+
+#ifndef _WIN32
+#include <fcntl.h>    // For open
+#include <sys/mman.h> // For mmap, madvise
+#include <sys/stat.h> // For fstat
+#include <unistd.h>   // For close
+#endif
+
+// Read-only view of a whole file. On POSIX systems the file is memory-mapped
+// so parsers can work on it in place; elsewhere it is read into one buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    // Returns false if the file does not exist or cannot be read
+    bool open(const std::string& path) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = size_t(st.st_size);
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            madvise(p, size_, MADV_SEQUENTIAL); // Parsers stream front to back
+            data_ = static_cast<const char*>(p);
+            mapped_ = true;
+        }
+        ::close(fd); // The mapping keeps the file alive
+        return true;
+#else
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) return false;
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buffer_.resize(len > 0 ? size_t(len) : 0);
+        size_ = buffer_.empty() ? 0 : fread(buffer_.data(), 1, buffer_.size(), f);
+        fclose(f);
+        data_ = buffer_.data();
+        return true;
+#endif
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+        buffer_.clear();
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+    }
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<char> buffer_;
+};
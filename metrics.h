@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>   // For the enable flag and shard counters
+#include <chrono>   // For timing
+#include <cstdint>  // For fixed-width counters
+#include <cstdio>   // For the metrics file
+#include <memory>   // For shard ownership
+#include <mutex>    // For registering shards (once per thread)
+#include <string>   // For report lines
+#include <vector>   // For the shard list
+
+// Hot-path instrumentation: call counts, bytes and latency histograms per
+// operation.
+//
+// Every thread records into its own shard, so recording never contends: a
+// counter update is a relaxed load and store of a location only that thread
+// writes, and readers (the report) sum the shards with relaxed loads. The
+// latency histogram has 8 sub-buckets per power of two of nanoseconds
+// (12.5% resolution), enough for p50/p99. Collection is off by default; a
+// disabled ScopedTimer costs one relaxed load and a branch, and never reads
+// the clock.
+
+enum class Metric {
+    AddCity,
+    AddRoad,
+    SetBudget,
+    EditCity,
+    DeleteCity,
+    DeleteRoad,
+    LocateCity,
+    History,
+    SearchCity,
+    FindCity,
+    SearchName,
+    ResizeGraph,
+    DisplayCities,
+    DisplayRoads,
+    DisplayAll,
+    Route,
+    RouteBatch,
+    Plan,
+    Optimize,
+    AllPairs,
+    Linked,
+    Nearby,
+    Components,
+    Analytics,
+    Region,
+    SaveCities,
+    SaveRoads,
+    SaveSnapshot,
+    SaveRegions,
+    JournalCommit,
+    LoadNetwork,
+    LoadRegion,
+    ImportRoads,
+    MenuInput,
+    Batch,
+    ServerRead,
+    ServerEdits,
+    Count
+};
+
+inline const char* metricName(Metric m) {
+    static const char* const kNames[] = {
+        "add_city", "add_road", "set_budget", "edit_city", "delete_city", "delete_road", "locate_city", "history",
+        "search_city", "find_city", "search_name", "resize_graph", "display_cities", "display_roads", "display_all",
+        "route", "route_batch", "plan", "optimize", "all_pairs", "linked", "nearby", "components", "analytics",
+        "region", "save_cities", "save_roads", "save_snapshot", "save_regions", "journal_commit", "load_network",
+        "load_region", "import_roads", "menu_input", "batch", "server_read", "server_edits",
+    };
+    static_assert(sizeof(kNames) / sizeof(kNames[0]) == size_t(Metric::Count), "one name per metric");
+    return kNames[size_t(m)];
+}
+
+class Metrics {
+public:
+    static constexpr size_t kMetrics = size_t(Metric::Count);
+    static constexpr size_t kSubBits = 3;   // 8 sub-buckets per power of two
+    static constexpr size_t kBuckets = 48 << kSubBits; // Up to 2^48 ns (3 days)
+
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void enable() { enabled_.store(true, std::memory_order_relaxed); }
+
+    void record(Metric m, uint64_t nanos, uint64_t bytes) {
+        Shard& s = localShard();
+        Counters& c = s.counters[size_t(m)];
+        bump(c.calls, 1);
+        bump(c.nanos, nanos);
+        if (bytes) bump(c.bytes, bytes);
+        bump(s.buckets[size_t(m) * kBuckets + bucketOf(nanos)], 1);
+    }
+
+    struct Summary {
+        uint64_t calls = 0, bytes = 0, nanos = 0;
+        double p50 = 0, p99 = 0; // Nanoseconds (bucket upper bounds)
+    };
+
+    Summary summary(Metric m) {
+        Summary sum;
+        std::vector<uint64_t> buckets(kBuckets, 0);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& s : shards_) {
+                const Counters& c = s->counters[size_t(m)];
+                sum.calls += c.calls.load(std::memory_order_relaxed);
+                sum.bytes += c.bytes.load(std::memory_order_relaxed);
+                sum.nanos += c.nanos.load(std::memory_order_relaxed);
+                for (size_t b = 0; b < kBuckets; ++b) {
+                    buckets[b] += s->buckets[size_t(m) * kBuckets + b].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        sum.p50 = quantile(buckets, 0.50);
+        sum.p99 = quantile(buckets, 0.99);
+        return sum;
+    }
+
+    // Human-readable table of every operation that ran
+    std::string report() {
+        std::string out = "Operation              Calls        Bytes     p50 (us)     p99 (us)   Total (ms)\n";
+        char line[160];
+        for (size_t i = 0; i < kMetrics; ++i) {
+            Summary s = summary(Metric(i));
+            if (s.calls == 0) continue;
+            std::snprintf(line, sizeof line, "%-18s %9llu %12llu %12.1f %12.1f %12.1f\n", metricName(Metric(i)),
+                          (unsigned long long)s.calls, (unsigned long long)s.bytes, s.p50 / 1e3, s.p99 / 1e3,
+                          s.nanos / 1e6);
+            out += line;
+        }
+        return out;
+    }
+
+    // Prometheus text exposition format
+    std::string prometheus() {
+        std::string calls = "# HELP roads_operation_calls_total Operations completed.\n"
+                            "# TYPE roads_operation_calls_total counter\n";
+        std::string bytes = "# HELP roads_operation_bytes_total Bytes written by I/O operations.\n"
+                            "# TYPE roads_operation_bytes_total counter\n";
+        std::string latency = "# HELP roads_operation_latency_seconds Operation latency.\n"
+                              "# TYPE roads_operation_latency_seconds summary\n";
+        char line[200];
+        for (size_t i = 0; i < kMetrics; ++i) {
+            Summary s = summary(Metric(i));
+            const char* op = metricName(Metric(i));
+            std::snprintf(line, sizeof line, "roads_operation_calls_total{op=\"%s\"} %llu\n", op, (unsigned long long)s.calls);
+            calls += line;
+            if (s.bytes) {
+                std::snprintf(line, sizeof line, "roads_operation_bytes_total{op=\"%s\"} %llu\n", op, (unsigned long long)s.bytes);
+                bytes += line;
+            }
+            std::snprintf(line, sizeof line,
+                          "roads_operation_latency_seconds{op=\"%s\",quantile=\"0.5\"} %.9f\n"
+                          "roads_operation_latency_seconds{op=\"%s\",quantile=\"0.99\"} %.9f\n"
+                          "roads_operation_latency_seconds_sum{op=\"%s\"} %.9f\n",
+                          op, s.p50 / 1e9, op, s.p99 / 1e9, op, s.nanos / 1e9);
+            latency += line;
+            std::snprintf(line, sizeof line, "roads_operation_latency_seconds_count{op=\"%s\"} %llu\n", op,
+                          (unsigned long long)s.calls);
+            latency += line;
+        }
+        return calls + bytes + latency;
+    }
+
+    bool writePrometheus(const std::string& path) {
+        std::string text = prometheus();
+        std::string tmpPath = path + ".tmp"; // Scrapers never see a half-written file
+        FILE* f = std::fopen(tmpPath.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+        if (std::fclose(f) != 0 || !ok) return false;
+#ifdef _WIN32
+        std::remove(path.c_str());
+#endif
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    struct Counters {
+        std::atomic<uint64_t> calls{0}, bytes{0}, nanos{0};
+    };
+    struct Shard {
+        Counters counters[kMetrics];
+        std::atomic<uint64_t> buckets[kMetrics * kBuckets] = {};
+    };
+
+    // Single writer per shard: no read-modify-write instruction needed
+    static void bump(std::atomic<uint64_t>& x, uint64_t by) {
+        x.store(x.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    static size_t bucketOf(uint64_t nanos) {
+        if (nanos < (1u << kSubBits)) return size_t(nanos);
+        size_t log = 63 - size_t(__builtin_clzll(nanos));
+        size_t sub = size_t(nanos >> (log - kSubBits)) & ((1u << kSubBits) - 1);
+        size_t b = ((log - kSubBits + 1) << kSubBits) + sub;
+        return b < kBuckets ? b : kBuckets - 1;
+    }
+
+    // Upper bound of bucket b in nanoseconds
+    static double bucketLimit(size_t b) {
+        if (b < (1u << kSubBits)) return double(b + 1);
+        size_t log = (b >> kSubBits) + kSubBits - 1;
+        size_t sub = b & ((1u << kSubBits) - 1);
+        return double((uint64_t(1) << log) + (uint64_t(sub + 1) << (log - kSubBits)));
+    }
+
+    static double quantile(const std::vector<uint64_t>& buckets, double q) {
+        uint64_t total = 0;
+        for (uint64_t c : buckets) total += c;
+        if (total == 0) return 0.0;
+        uint64_t rank = uint64_t(q * double(total - 1)) + 1, seen = 0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            seen += buckets[b];
+            if (seen >= rank) return bucketLimit(b);
+        }
+        return bucketLimit(buckets.size() - 1);
+    }
+
+    Shard& localShard() {
+        thread_local Shard* shard = nullptr;
+        if (!shard) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shards_.emplace_back(new Shard); // Outlives the thread, so its counts stay in the report
+            shard = shards_.back().get();
+        }
+        return *shard;
+    }
+
+    std::atomic<bool> enabled_{false};
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+// Times its scope into one metric when collection is enabled
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Metric metric) : metric_(metric), active_(Metrics::instance().enabled()) {
+        if (active_) start_ = std::chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (!active_) return;
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+        Metrics::instance().record(metric_, uint64_t(nanos.count()), bytes_);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    void addBytes(uint64_t bytes) { bytes_ += bytes; }
+
+private:
+    Metric metric_;
+    bool active_;
+    uint64_t bytes_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
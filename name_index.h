@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>   // For sort, min
+#include <cstdint>     // For fixed-width ids
+#include <string>      // For the key arenas
+#include <string_view> // Queries and names are views
+#include <utility>     // For pair
+#include <vector>      // For the node, rank and row arrays
+#include "city_table.h" // Built from the live city names
+
+// Name search over the cities: prefix completion and typo-tolerant matching.
+//
+// Names are folded to lower case (ASCII) and kept in a radix trie. Every
+// node is one array entry holding its edge label (a span of the key arena),
+// its first child and next sibling (siblings by first byte), the cities
+// whose name ends there and the number of names below it, so a prefix lookup
+// walks one path and the completions are that node's subtree, in order.
+// Adding, renaming or deleting a city inserts or erases one key: a split or
+// a merge of nodes along its path, no rebuild. Freed nodes are reused; the
+// arena only grows, and the index asks for a rebuild once it is mostly
+// garbage.
+//
+// Similar names are found by walking a trie with one row of the edit
+// distance table per trie depth (a Levenshtein automaton run over the trie):
+// a row only depends on the row above, so a shared prefix is matched once for
+// all the names under it, and a subtree is skipped as soon as no cell of its
+// row is within the limit. Near the root that prunes little, so the limit is
+// split: a name within k edits of the query is within k / 2 edits of its
+// first half, or within (k - 1) / 2 of its second half. The first case is
+// searched with the tight limit on the first half of the query, the second
+// on a trie of the reversed names, so both walks prune from the first bytes.
+// An adjacent transposition counts as one edit, as in the typos people make.
+class NameIndex {
+public:
+    // Index the live cities of the table. The index reads names from it
+    // (to order matches), so the table must outlive it.
+    void build(const CityTable& cities) {
+        cities_ = &cities;
+        std::vector<std::pair<std::string, uint32_t>> names; // (folded name, id)
+        names.reserve(cities.liveCount());
+        keyBytes_ = 0;
+        for (uint32_t i = 0; i < cities.size(); ++i) {
+            if (!cities.alive(i)) continue;
+            names.push_back({folded(cities[i]), i});
+            keyBytes_ += names.back().first.size();
+        }
+        forward_.build(names);
+        for (auto& n : names) std::reverse(n.first.begin(), n.first.end());
+        backward_.build(names);
+        stale_ = false;
+    }
+
+    // Index city id under name, after the table added it or renamed it to
+    // name. O(name length); nothing to do while the index is stale.
+    void insert(uint32_t id, std::string_view name) {
+        if (stale_) return;
+        std::string key = folded(name);
+        forward_.insert(key, id);
+        std::reverse(key.begin(), key.end());
+        backward_.insert(key, id);
+        keyBytes_ += key.size();
+    }
+
+    // Drop city id, indexed under name, before the table removes or renames it
+    void erase(uint32_t id, std::string_view name) {
+        if (stale_) return;
+        std::string key = folded(name);
+        forward_.erase(key, id);
+        std::reverse(key.begin(), key.end());
+        backward_.erase(key, id);
+        keyBytes_ -= key.size();
+        if (forward_.keys.size() + backward_.keys.size() > 4 * keyBytes_ + 4096) stale_ = true; // Mostly garbage
+    }
+
+    void invalidate() { stale_ = true; }
+    bool stale() const { return stale_; }
+    size_t size() const { return forward_.nodes[0].count; }
+
+    // Cities whose name starts with prefix (ignoring case), alphabetically:
+    // the first `limit` go to out. Returns how many there are in all.
+    size_t complete(std::string_view prefix, size_t limit, std::vector<uint32_t>& out) const {
+        uint32_t at = forward_.find(folded(prefix));
+        if (at == kNone) return 0;
+        size_t taken = 0;
+        std::vector<uint32_t> stack{at}, children;
+        while (!stack.empty() && taken < limit) {
+            const Node& node = forward_.nodes[stack.back()];
+            stack.pop_back();
+            for (uint32_t id = node.endId; id != kNone && taken < limit; id = forward_.sameKey[id], ++taken) out.push_back(id);
+            children.clear();
+            for (uint32_t c = node.child; c != kNone; c = forward_.nodes[c].sibling) children.push_back(c);
+            stack.insert(stack.end(), children.rbegin(), children.rend()); // Lowest byte on top
+        }
+        return forward_.nodes[at].count;
+    }
+
+    // Cities whose name is at most maxEdits insertions, deletions,
+    // substitutions or adjacent swaps away from name (ignoring case), as
+    // (id, edits): the closest `limit`, fewest edits first, then by name.
+    // The limit is raised one edit at a time until there are enough, so a
+    // near miss costs no more than its own distance.
+    std::vector<std::pair<uint32_t, uint32_t>> similar(std::string_view name, uint32_t maxEdits, size_t limit) const {
+        std::vector<std::pair<uint32_t, uint32_t>> found; // (edits, id) until the end
+        if (size() == 0 || limit == 0) return found;
+        std::string query = folded(name);
+        std::string reversed(query.rbegin(), query.rend());
+        const uint32_t half = uint32_t(query.size() / 2);
+        for (uint32_t edits = 0; edits <= maxEdits && found.size() < limit; ++edits) {
+            found.clear();
+            forward_.search(query, edits, half, edits / 2, found);
+            if (edits > 0) backward_.search(reversed, edits, uint32_t(query.size()) - half, (edits - 1) / 2, found);
+            std::sort(found.begin(), found.end());
+            found.erase(std::unique(found.begin(), found.end()), found.end()); // Found by both walks
+        }
+        std::sort(found.begin(), found.end(), [&](const auto& a, const auto& b) {
+            if (a.first != b.first) return a.first < b.first;
+            std::string_view x = (*cities_)[a.second], y = (*cities_)[b.second];
+            for (size_t j = 0; j < x.size() && j < y.size(); ++j) {
+                if (fold(x[j]) != fold(y[j])) return fold(x[j]) < fold(y[j]);
+            }
+            return x.size() != y.size() ? x.size() < y.size() : a.second < b.second;
+        });
+        if (found.size() > limit) found.resize(limit);
+        for (auto& f : found) f = {f.second, f.first};
+        return found;
+    }
+
+    // Edit limit that still finds most typos without flooding short names
+    static uint32_t defaultEdits(size_t length) { return length < 5 ? 1 : length < 10 ? 2 : 3; }
+
+private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+    static constexpr uint32_t kFar = 1u << 30; // Table cell outside the band
+
+    struct Node {
+        uint32_t label = 0;       // Edge label: keys[label, label + length)
+        uint32_t length = 0;
+        uint32_t child = kNone;   // First child; siblings follow by first byte
+        uint32_t sibling = kNone;
+        uint32_t endId = kNone;   // First city whose key ends here; the rest follow in sameKey
+        uint32_t count = 0;       // Keys in this subtree
+    };
+
+    struct Trie {
+        std::string keys;              // Edge labels; append-only until the next build
+        std::vector<Node> nodes = std::vector<Node>(1); // nodes[0] is the root, with an empty label
+        std::vector<uint32_t> unused;  // Node slots freed by erase()
+        std::vector<uint32_t> sameKey; // City index -> next city with the same key, ascending
+
+        // Insert the keys in sorted order, so siblings and subtrees end up
+        // next to each other in nodes and keys
+        void build(std::vector<std::pair<std::string, uint32_t>>& names) {
+            std::sort(names.begin(), names.end());
+            keys.clear();
+            nodes.assign(1, Node());
+            unused.clear();
+            sameKey.clear();
+            for (const auto& n : names) insert(n.first, n.second);
+        }
+
+        uint32_t newNode(const Node& node) {
+            if (unused.empty()) {
+                nodes.push_back(node);
+                return uint32_t(nodes.size() - 1);
+            }
+            uint32_t at = unused.back();
+            unused.pop_back();
+            nodes[at] = node;
+            return at;
+        }
+
+        // Child of at starting with byte c, or kNone; prev gets the sibling
+        // before where it is (or would go), kNone for the first
+        uint32_t childAt(uint32_t at, char c, uint32_t& prev) const {
+            prev = kNone;
+            for (uint32_t k = nodes[at].child; k != kNone; prev = k, k = nodes[k].sibling) {
+                char first = keys[nodes[k].label];
+                if (first == c) return k;
+                if (uint8_t(first) > uint8_t(c)) break;
+            }
+            return kNone;
+        }
+
+        void insert(std::string_view key, uint32_t id) {
+            if (sameKey.size() <= id) sameKey.resize(size_t(id) + 1, kNone);
+            uint32_t at = 0;
+            size_t matched = 0;
+            ++nodes[0].count;
+            while (matched < key.size()) {
+                uint32_t prev, next = childAt(at, key[matched], prev);
+                if (next == kNone) { // New leaf for the rest of the key
+                    Node leaf;
+                    leaf.label = uint32_t(keys.size());
+                    leaf.length = uint32_t(key.size() - matched);
+                    leaf.sibling = prev == kNone ? nodes[at].child : nodes[prev].sibling;
+                    leaf.endId = id;
+                    leaf.count = 1;
+                    keys.append(key.substr(matched));
+                    uint32_t added = newNode(leaf);
+                    (prev == kNone ? nodes[at].child : nodes[prev].sibling) = added;
+                    sameKey[id] = kNone;
+                    return;
+                }
+                uint32_t k = 1;
+                while (k < nodes[next].length && matched + k < key.size() &&
+                       keys[nodes[next].label + k] == key[matched + k]) ++k;
+                if (k < nodes[next].length) { // The key leaves the label midway: split it there
+                    Node rest = nodes[next];
+                    rest.label += k;
+                    rest.length -= k;
+                    rest.sibling = kNone;
+                    uint32_t tail = newNode(rest);
+                    Node& head = nodes[next];
+                    head.length = k;
+                    head.child = tail;
+                    head.endId = kNone;
+                }
+                ++nodes[next].count;
+                matched += k;
+                at = next;
+            }
+            uint32_t* link = &nodes[at].endId; // Keep the ids ascending
+            while (*link != kNone && *link < id) link = &sameKey[*link];
+            sameKey[id] = *link;
+            *link = id;
+        }
+
+        // Remove id from key; prune the nodes left empty and merge a node
+        // left with a single child and no key into that child
+        void erase(std::string_view key, uint32_t id) {
+            std::vector<uint32_t> path{0}, before{kNone}; // Nodes on the way down, and the sibling before each
+            size_t matched = 0;
+            while (matched < key.size()) {
+                uint32_t prev, next = childAt(path.back(), key[matched], prev);
+                if (next == kNone || nodes[next].length > key.size() - matched ||
+                    key.compare(matched, nodes[next].length, std::string_view(keys).substr(nodes[next].label, nodes[next].length)) != 0) {
+                    return; // Not indexed
+                }
+                matched += nodes[next].length;
+                path.push_back(next);
+                before.push_back(prev);
+            }
+            uint32_t* link = &nodes[path.back()].endId;
+            while (*link != kNone && *link != id) link = &sameKey[*link];
+            if (*link == kNone) return;
+            *link = sameKey[id];
+            for (uint32_t at : path) --nodes[at].count;
+
+            size_t d = path.size() - 1;
+            for (; d > 0 && nodes[path[d]].count == 0; --d) { // Unlink empty nodes
+                uint32_t parent = path[d - 1];
+                (before[d] == kNone ? nodes[parent].child : nodes[before[d]].sibling) = nodes[path[d]].sibling;
+                unused.push_back(path[d]);
+            }
+            uint32_t at = path[d];
+            if (d == 0 || nodes[at].endId != kNone || nodes[at].child == kNone || nodes[nodes[at].child].sibling != kNone) return;
+            uint32_t only = nodes[at].child;
+            Node& node = nodes[at];
+            const Node& below = nodes[only];
+            if (node.label + node.length != below.label) { // Labels not adjacent: copy them together
+                std::string joined = keys.substr(node.label, node.length) + keys.substr(below.label, below.length);
+                node.label = uint32_t(keys.size());
+                keys += joined;
+            }
+            node.length += below.length;
+            node.child = below.child;
+            node.endId = below.endId;
+            unused.push_back(only);
+        }
+
+        // Node whose subtree holds the keys starting with prefix, or kNone
+        uint32_t find(std::string_view prefix) const {
+            uint32_t at = 0;
+            size_t matched = 0;
+            while (matched < prefix.size()) {
+                uint32_t prev;
+                at = childAt(at, prefix[matched], prev);
+                if (at == kNone) return kNone;
+                const Node& node = nodes[at];
+                for (uint32_t k = 0; k < node.length && matched < prefix.size(); ++k, ++matched) {
+                    if (keys[node.label + k] != prefix[matched]) return kNone;
+                }
+            }
+            return nodes[at].count > 0 ? at : kNone;
+        }
+
+        // Append (edits, id) for every key within maxEdits of query whose
+        // first split bytes are matched within splitEdits. Row d of the table
+        // is only computed on the band |j - d| <= maxEdits, and the cells just
+        // outside it are set to kFar so the next row never reads stale ones.
+        // A subtree is pruned once no cell of its row is within the limit of
+        // its column: splitEdits up to split (one more at split itself, where
+        // a swap across the split lands), maxEdits past it.
+        void search(const std::string& query, uint32_t maxEdits, uint32_t split, uint32_t splitEdits,
+                    std::vector<std::pair<uint32_t, uint32_t>>& found) const {
+            if (nodes[0].count == 0) return;
+            const uint32_t m = uint32_t(query.size()), width = m + 1;
+            auto limit = [&](uint32_t j) {
+                return j < split ? splitEdits : j == split ? std::min(splitEdits + 1, maxEdits) : maxEdits;
+            };
+            std::vector<uint32_t> rows(width, kFar); // rows[d * width + j]: edits between the path's first d bytes and query[0, j)
+            std::string path;                        // Bytes from the root to the current depth
+            for (uint32_t j = 0; j <= std::min(m, maxEdits); ++j) rows[j] = j;
+
+            std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 0}}; // (node, depth above its label)
+            while (!stack.empty()) {
+                auto [at, depth] = stack.back();
+                stack.pop_back();
+                const Node& node = nodes[at];
+                bool reachable = true;
+                for (uint32_t k = 0; k < node.length && reachable; ++k) {
+                    uint32_t d = depth + k + 1;
+                    if (d > m + maxEdits) {
+                        reachable = false;
+                        break;
+                    }
+                    if (rows.size() < size_t(d + 1) * width) rows.resize(size_t(d + 1) * width, kFar);
+                    if (path.size() < d) path.resize(d);
+                    char c = keys[node.label + k];
+                    path[d - 1] = c;
+                    const uint32_t* above = &rows[size_t(d - 1) * width];
+                    const uint32_t* twoAbove = d > 1 ? &rows[size_t(d - 2) * width] : nullptr;
+                    uint32_t* row = &rows[size_t(d) * width];
+                    uint32_t lo = d > maxEdits ? d - maxEdits : 1, hi = std::min(m, d + maxEdits);
+                    row[0] = d;
+                    if (lo > 1) row[lo - 1] = kFar;
+                    reachable = d <= limit(0);
+                    for (uint32_t j = lo; j <= hi; ++j) {
+                        uint32_t cost = std::min({above[j] + 1, row[j - 1] + 1, above[j - 1] + (query[j - 1] != c)});
+                        if (twoAbove && j > 1 && query[j - 1] == path[d - 2] && query[j - 2] == c) {
+                            cost = std::min(cost, twoAbove[j - 2] + 1); // Swapped pair
+                        }
+                        row[j] = cost;
+                        reachable = reachable || cost <= limit(j);
+                    }
+                    if (hi < m) row[hi + 1] = kFar;
+                }
+                if (!reachable) continue;
+                uint32_t d = depth + node.length;
+                uint32_t edits = d + maxEdits >= m ? rows[size_t(d) * width + m] : kFar;
+                if (edits <= maxEdits) {
+                    for (uint32_t id = node.endId; id != kNone; id = sameKey[id]) found.push_back({edits, id});
+                }
+                for (uint32_t c = node.child; c != kNone; c = nodes[c].sibling) stack.push_back({c, d});
+            }
+        }
+    };
+
+    static char fold(char c) { return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c; }
+
+    static std::string folded(std::string_view name) {
+        std::string key(name.size(), '\0');
+        for (size_t j = 0; j < name.size(); ++j) key[j] = fold(name[j]);
+        return key;
+    }
+
+    const CityTable* cities_ = nullptr;
+    Trie forward_;         // Folded names
+    Trie backward_;        // Folded names spelled backwards
+    size_t keyBytes_ = 0;  // Bytes of the names indexed (in each trie)
+    bool stale_ = true;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm> // For sort
+#include <atomic>    // For lock-free cheapest-edge updates
+#include <cstdint>   // For fixed-width ids
+#include <memory>    // For the atomic slot array
+#include <vector>    // For edge lists and labels
+#include "parallel.h"   // For parallelFor
+#include "road_graph.h" // Plans are computed over the road graph
+#include "union_find.h" // For Kruskal and component merging
+
+// Minimum-cost network planning: the cheapest set of roads that keeps every
+// currently connected group of cities connected (a minimum spanning forest
+// over road budgets).
+
+struct NetworkPlan {
+    std::vector<RoadGraph::Road> roads; // Selected roads, from < to
+    double totalBudget = 0.0;
+    uint32_t components = 0;            // Connected groups of cities (1 = fully connected)
+};
+
+// Kruskal: sort every road by budget and keep those that join two groups
+inline NetworkPlan planKruskal(const RoadGraph& graph) {
+    std::vector<RoadGraph::Road> edges;
+    edges.reserve(graph.roadCount());
+    graph.forEachRoad([&](uint32_t a, uint32_t b, double budget) { edges.push_back({a, b, budget}); });
+    std::sort(edges.begin(), edges.end(), [](const RoadGraph::Road& x, const RoadGraph::Road& y) {
+        if (x.budget != y.budget) return x.budget < y.budget;
+        return x.from != y.from ? x.from < y.from : x.to < y.to;
+    });
+
+    NetworkPlan plan;
+    UnionFind groups(graph.cityCount());
+    for (const RoadGraph::Road& e : edges) {
+        if (!groups.unite(e.from, e.to)) continue;
+        plan.roads.push_back(e);
+        plan.totalBudget += e.budget;
+        if (groups.setCount() == 1) break;
+    }
+    plan.components = groups.setCount();
+    return plan;
+}
+
+// Parallel Boruvka. Each round every worker scans its share of the remaining
+// roads and records, per group, the cheapest road leaving it (lock-free, by
+// compare-and-swap on the road index). The chosen roads are then merged, cities
+// are relabelled with their new group and roads inside a group are dropped.
+// Every round at least halves the number of groups. Ties are broken by road
+// index, which keeps the choice consistent and the result a forest.
+inline NetworkPlan planBoruvka(const RoadGraph& graph) {
+    std::vector<RoadGraph::Road> edges;
+    edges.reserve(graph.roadCount());
+    graph.forEachRoad([&](uint32_t a, uint32_t b, double budget) { edges.push_back({a, b, budget}); });
+
+    const uint32_t n = graph.cityCount();
+    const uint32_t kNone = 0xFFFFFFFFu;
+    std::vector<uint32_t> group(n);
+    for (uint32_t i = 0; i < n; ++i) group[i] = i;
+    std::unique_ptr<std::atomic<uint32_t>[]> cheapest(new std::atomic<uint32_t>[n]);
+    std::vector<uint32_t> live(edges.size()); // Indices of roads between different groups
+    for (uint32_t i = 0; i < live.size(); ++i) live[i] = i;
+
+    auto cheaper = [&](uint32_t x, uint32_t y) { // Strict total order on roads
+        if (y == kNone) return true;
+        return edges[x].budget != edges[y].budget ? edges[x].budget < edges[y].budget : x < y;
+    };
+    auto offer = [&](uint32_t g, uint32_t e) {
+        uint32_t cur = cheapest[g].load(std::memory_order_relaxed);
+        while (cheaper(e, cur) && !cheapest[g].compare_exchange_weak(cur, e, std::memory_order_relaxed)) {
+        }
+    };
+
+    NetworkPlan plan;
+    UnionFind groups(n);
+    while (!live.empty()) {
+        parallelFor(n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t g = begin; g < end; ++g) cheapest[g].store(kNone, std::memory_order_relaxed);
+        });
+        parallelFor(live.size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t e = live[i];
+                offer(group[edges[e].from], e);
+                offer(group[edges[e].to], e);
+            }
+        });
+
+        // Merge along every group's cheapest road (sequential: one step per group)
+        bool merged = false;
+        for (uint32_t g = 0; g < n; ++g) {
+            uint32_t e = cheapest[g].load(std::memory_order_relaxed);
+            if (e == kNone || !groups.unite(edges[e].from, edges[e].to)) continue;
+            plan.roads.push_back(edges[e]);
+            plan.totalBudget += edges[e].budget;
+            merged = true;
+        }
+        if (!merged) break;
+
+        // Relabel cities: roots first (find mutates), then a parallel copy
+        std::vector<uint32_t> root(n);
+        for (uint32_t v = 0; v < n; ++v) root[v] = groups.find(v);
+        parallelFor(n, [&](size_t begin, size_t end, unsigned) {
+            for (size_t v = begin; v < end; ++v) group[v] = root[v];
+        });
+
+        // Drop roads that now lie inside one group, compacting each worker's chunk
+        std::vector<size_t> kept(workerCount() + 1, 0);
+        std::vector<size_t> chunkBegin(workerCount(), 0);
+        parallelFor(live.size(), [&](size_t begin, size_t end, unsigned w) {
+            size_t out = begin;
+            for (size_t i = begin; i < end; ++i) {
+                const RoadGraph::Road& r = edges[live[i]];
+                if (group[r.from] != group[r.to]) live[out++] = live[i];
+            }
+            chunkBegin[w] = begin;
+            kept[w] = out - begin;
+        });
+        size_t total = 0;
+        for (size_t w = 0; w < chunkBegin.size(); ++w) {
+            for (size_t i = 0; i < kept[w]; ++i) live[total + i] = live[chunkBegin[w] + i];
+            total += kept[w];
+        }
+        live.resize(total);
+    }
+    plan.components = groups.setCount();
+    return plan;
+}
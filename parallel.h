@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm> // For min
+#include <cstddef>   // For size_t
+#include <thread>    // For worker threads
+#include <vector>    // For the thread list
+
+// Number of worker threads to use for parallel kernels
+inline unsigned workerCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Split [0, n) into one contiguous chunk per worker and run
+// fn(begin, end, worker) on each; the calling thread takes the first chunk.
+// Small ranges (under minPerWorker items per worker) use fewer workers.
+template <class Fn>
+void parallelFor(size_t n, Fn fn, size_t minPerWorker = 4096) {
+    size_t workers = std::min<size_t>(workerCount(), std::max<size_t>(1, n / std::max<size_t>(1, minPerWorker)));
+    if (workers <= 1) {
+        fn(size_t(0), n, 0u);
+        return;
+    }
+    size_t chunk = (n + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t w = 1; w < workers; ++w) {
+        size_t begin = std::min(n, w * chunk), end = std::min(n, begin + chunk);
+        threads.emplace_back([=, &fn] { fn(begin, end, unsigned(w)); });
+    }
+    fn(size_t(0), std::min(n, chunk), 0u);
+    for (std::thread& t : threads) t.join();
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm> // For max
+#include <cstdint>   // For fixed-width ids
+#include <utility>   // For pair
+#include <vector>    // For the region arrays
+#include "road_graph.h" // Regions are cut out of the road graph
+
+// Split the cities into regions of about the same size with as few roads as
+// possible running between regions, for sharded storage.
+//
+// Regions are first grown one at a time, breadth-first from a seed, until
+// they hold their share of the cities (greedy graph growing). Each seed is
+// the first unassigned city in a breadth-first order of the whole network,
+// so a new region starts next to the ones grown before it and leftover
+// pockets stay small. Then passes of boundary refinement move a city to the
+// neighbouring region holding most of its roads whenever that removes cut
+// roads and keeps both regions within kSlack of the average size, until a
+// pass moves nothing. O((cities + roads) * passes).
+struct Partition {
+    static constexpr uint32_t kNoRegion = 0xFFFFFFFFu;
+
+    std::vector<uint32_t> regionOf; // City -> region, kNoRegion for dead cities
+    std::vector<uint32_t> size;     // Cities per region
+    size_t cutRoads = 0;            // Roads between two regions
+};
+
+template <class Alive>
+Partition partitionCities(const RoadGraph& graph, uint32_t regions, Alive alive) {
+    constexpr double kSlack = 0.03;
+    constexpr int kMaxPasses = 20;
+    const uint32_t n = graph.cityCount();
+    Partition p;
+    p.regionOf.assign(n, Partition::kNoRegion);
+    p.size.assign(std::max(1u, regions), 0);
+    regions = uint32_t(p.size.size());
+
+    // Breadth-first order of every live city, component after component
+    std::vector<uint32_t> order;
+    std::vector<char> seen(n, 0);
+    for (uint32_t s = 0; s < n; ++s) {
+        if (seen[s] || !alive(s)) continue;
+        seen[s] = 1;
+        size_t at = order.size();
+        order.push_back(s);
+        for (; at < order.size(); ++at) {
+            graph.forEachNeighbor(order[at], [&](uint32_t v, double) {
+                if (!seen[v]) {
+                    seen[v] = 1;
+                    order.push_back(v);
+                }
+            });
+        }
+    }
+    const uint32_t live = uint32_t(order.size());
+
+    // Grow each region to its share, from the first unassigned city of order
+    std::vector<uint32_t> queue;
+    size_t next = 0;
+    for (uint32_t r = 0; r < regions; ++r) {
+        uint32_t share = uint32_t((uint64_t(live) * (r + 1)) / regions - (uint64_t(live) * r) / regions);
+        while (p.size[r] < share) {
+            while (p.regionOf[order[next]] != Partition::kNoRegion) ++next;
+            queue.assign(1, order[next]);
+            p.regionOf[order[next]] = r;
+            ++p.size[r];
+            for (size_t at = 0; at < queue.size() && p.size[r] < share; ++at) {
+                graph.forEachNeighbor(queue[at], [&](uint32_t v, double) {
+                    if (p.regionOf[v] != Partition::kNoRegion || p.size[r] >= share) return;
+                    p.regionOf[v] = r;
+                    ++p.size[r];
+                    queue.push_back(v);
+                });
+            }
+        }
+    }
+
+    // Move boundary cities to the region most of their roads lead to
+    const double average = double(live) / regions;
+    const uint32_t most = uint32_t(average * (1 + kSlack)) + 1;
+    const uint32_t least = uint32_t(std::max(0.0, average * (1 - kSlack)));
+    std::vector<std::pair<uint32_t, uint32_t>> links; // (region, roads to it) of one city
+    for (int pass = 0; pass < kMaxPasses; ++pass) {
+        size_t moves = 0;
+        for (uint32_t u : order) {
+            uint32_t home = p.regionOf[u];
+            links.clear();
+            graph.forEachNeighbor(u, [&](uint32_t v, double) {
+                uint32_t r = p.regionOf[v];
+                for (auto& l : links) {
+                    if (l.first == r) {
+                        ++l.second;
+                        return;
+                    }
+                }
+                links.push_back({r, 1});
+            });
+            uint32_t inside = 0, best = home, bestRoads = 0;
+            for (const auto& l : links) {
+                if (l.first == home) inside = l.second;
+                else if (l.second > bestRoads && p.size[l.first] < most) {
+                    best = l.first;
+                    bestRoads = l.second;
+                }
+            }
+            if (best == home || bestRoads <= inside || p.size[home] <= least) continue;
+            p.regionOf[u] = best;
+            --p.size[home];
+            ++p.size[best];
+            ++moves;
+        }
+        if (moves == 0) break;
+    }
+
+    graph.forEachRoad([&](uint32_t a, uint32_t b, double) { p.cutRoads += p.regionOf[a] != p.regionOf[b]; });
+    return p;
+}
@@ -0,0 +1,446 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include <atomic>             // For the published snapshot and the stop flag
+#include <charconv>           // For number formatting and parsing
+#include <condition_variable> // For waking the writer
+#include <cstdint>            // For fixed-width ids
+#include <functional>         // For the edit and snapshot callbacks
+#include <memory>             // For the worker list
+#include <mutex>              // For the edit queue and worker inboxes
+#include <string>             // For connection buffers and replies
+#include <string_view>        // For parsing request lines
+#include <thread>             // For workers and the writer
+#include <unordered_map>      // For a worker's connections
+#include <utility>            // For pair, move
+#include <vector>             // For queues and poll sets
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "city_table.h"  // Snapshot city names
+#include "epoch.h"       // Reclaiming retired snapshots
+#include "metrics.h"     // Read and edit-group latency
+#include "road_graph.h"  // Snapshot road graph
+#include "routing.h"     // ROUTE queries
+#include "text_format.h" // For splitCityPair
+
+// Immutable copy of the network that readers query. The writer builds one
+// after each group of edits and publishes it whole; it is never modified
+// once published.
+struct NetworkSnapshot {
+    CityTable cities;
+    RoadGraph graph;             // Compacted: every road is in the CSR arrays
+    std::vector<uint32_t> group; // Connected group of each city
+    uint64_t version = 0;
+};
+
+// Local query daemon on a Unix domain socket.
+//
+// Line protocol, one reply line per request line. Reads (CITY, NAME, BUDGET,
+// ROUTE, LINKED, INFO) are answered by worker threads from the currently
+// published NetworkSnapshot, which they pin with an epoch guard, so the read
+// path takes no locks and a writer never makes a reader wait. Edits
+// (ADD_CITY, ADD_ROAD, SET_BUDGET, EDIT, DELETE_CITY, DELETE_ROAD, LOCATE) are queued
+// to the single writer thread, which applies everything queued so far,
+// commits it as one group, publishes a fresh snapshot and only then replies,
+// so a client always sees its own edits. A connection with an edit in flight
+// is not read from until the reply arrives; its worker keeps serving the
+// other connections.
+class QueryServer {
+public:
+    // apply(command, arg, error) runs an edit against the live network;
+    // build() copies the live network into a new snapshot; commit() makes a
+    // group of applied edits durable. All three run on the writer thread only.
+    using Apply = std::function<bool(std::string_view, std::string_view, std::string&)>;
+    using Build = std::function<NetworkSnapshot*()>;
+    using Commit = std::function<void()>;
+
+    QueryServer(unsigned workers, Apply apply, Build build, Commit commit)
+        : apply_(std::move(apply)), build_(std::move(build)), commit_(std::move(commit)),
+          epochs_(workers == 0 ? 1 : workers) {
+        for (unsigned i = 0; i < (workers == 0 ? 1 : workers); ++i) workers_.emplace_back(new Worker);
+        publish(build_());
+    }
+
+    ~QueryServer() {
+        if (listenFd_ != -1) ::close(listenFd_);
+        if (!path_.empty()) ::unlink(path_.c_str());
+        for (int fd : stopPipe_) {
+            if (fd != -1) ::close(fd);
+        }
+        for (auto& w : workers_) {
+            for (int fd : w->wake) {
+                if (fd != -1) ::close(fd);
+            }
+        }
+        delete current_.load();
+    }
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Bind and listen on path (a stale socket file is replaced)
+    bool listen(const std::string& path, std::string& error) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof addr.sun_path) {
+            error = "socket path is too long";
+            return false;
+        }
+        if (!makePipe(stopPipe_)) {
+            error = "could not create a pipe";
+            return false;
+        }
+        for (auto& w : workers_) {
+            if (!makePipe(w->wake)) {
+                error = "could not create a pipe";
+                return false;
+            }
+        }
+        listenFd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd_ == -1) {
+            error = "could not create a socket";
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, path.size());
+        ::unlink(path.c_str());
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 || ::listen(listenFd_, 128) != 0) {
+            error = "could not bind " + path;
+            return false;
+        }
+        path_ = path;
+        setNonBlocking(listenFd_);
+        return true;
+    }
+
+    // Accept connections and serve them until stop(). Edits still queued
+    // when stopping are applied and committed before this returns.
+    void run() {
+        std::thread writer([this] { writerLoop(); });
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            workers_[i]->thread = std::thread([this, i] { workerLoop(i); });
+        }
+        size_t next = 0;
+        for (;;) {
+            pollfd fds[2] = {{listenFd_, POLLIN, 0}, {stopPipe_[0], POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0 && errno != EINTR) break;
+            if (fds[1].revents) break;
+            if (!(fds[0].revents & POLLIN)) continue;
+            int fd;
+            while ((fd = ::accept(listenFd_, nullptr, nullptr)) != -1) {
+                setNonBlocking(fd);
+                Worker& w = *workers_[next++ % workers_.size()]; // Round robin
+                {
+                    std::lock_guard<std::mutex> lock(w.mutex);
+                    w.newConnections.push_back(fd);
+                }
+                wake(w);
+            }
+        }
+
+        stopping_.store(true);
+        for (auto& w : workers_) {
+            wake(*w);
+            w->thread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(editMutex_);
+        }
+        editReady_.notify_one();
+        writer.join();
+    }
+
+    // Ask run() to return. Only writes to a pipe, so it is safe to call from
+    // a signal handler.
+    void stop() {
+        if (stopPipe_[1] != -1) {
+            char c = 0;
+            (void)!::write(stopPipe_[1], &c, 1);
+        }
+    }
+
+private:
+    struct Connection {
+        int fd;
+        std::string in;       // Bytes received, not yet handled
+        size_t consumed = 0;  // Prefix of in already handled
+        std::string out;      // Replies not yet sent
+        bool waiting = false; // An edit is in flight
+        bool eof = false;     // Peer sent everything it will send
+        bool closing = false; // QUIT received
+        bool done() const { return (closing || (eof && !waiting)) && out.empty(); }
+    };
+
+    struct Worker {
+        std::thread thread;
+        int wake[2] = {-1, -1};
+        std::mutex mutex; // Guards the two inbox lists below
+        std::vector<int> newConnections;
+        std::vector<std::pair<uint64_t, std::string>> replies; // Connection id -> edit reply
+        RoutePlanner planner;                                    // Per-thread search state
+    };
+
+    struct Edit {
+        size_t worker;
+        uint64_t connection;
+        std::string command, arg, reply;
+    };
+
+    static constexpr size_t kMaxLine = 1 << 16; // Longer requests close the connection
+    static constexpr size_t kMaxPending = 1 << 20; // Stop reading ahead past this much input
+
+    static void setNonBlocking(int fd) { ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+    static bool makePipe(int fds[2]) {
+        if (::pipe(fds) != 0) return false;
+        setNonBlocking(fds[0]);
+        setNonBlocking(fds[1]); // A full pipe already means a wake-up is pending
+        return true;
+    }
+
+    static void wake(Worker& w) {
+        char c = 0;
+        (void)!::write(w.wake[1], &c, 1);
+    }
+
+    // Writer only: make s the snapshot new readers see
+    void publish(NetworkSnapshot* s) {
+        s->version = ++version_;
+        NetworkSnapshot* old = current_.exchange(s);
+        if (old) epochs_.retire([old] { delete old; });
+    }
+
+    void writerLoop() {
+        std::vector<Edit> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(editMutex_);
+                editReady_.wait(lock, [&] { return stopping_.load() || !edits_.empty(); });
+                if (edits_.empty()) return; // Stopping with nothing left to apply
+                batch.swap(edits_);
+            }
+            ScopedTimer timer(Metric::ServerEdits);
+            bool changed = false;
+            for (Edit& e : batch) {
+                std::string error;
+                if (apply_(e.command, e.arg, error)) {
+                    e.reply = "OK\n";
+                    changed = true;
+                } else {
+                    e.reply = "ERR " + error + "\n";
+                }
+            }
+            if (changed) { // One commit and one snapshot for the whole group
+                commit_();
+                publish(build_());
+            }
+            for (Edit& e : batch) {
+                Worker& w = *workers_[e.worker];
+                {
+                    std::lock_guard<std::mutex> lock(w.mutex);
+                    w.replies.emplace_back(e.connection, std::move(e.reply));
+                }
+                wake(w);
+            }
+            batch.clear();
+        }
+    }
+
+    void workerLoop(size_t index) {
+        Worker& w = *workers_[index];
+        std::unordered_map<uint64_t, Connection> connections;
+        uint64_t nextId = 0;
+        std::vector<pollfd> fds;
+        std::vector<uint64_t> ids;
+        std::vector<int> fresh;
+        std::vector<std::pair<uint64_t, std::string>> replies;
+        while (!stopping_.load()) {
+            fds.assign(1, pollfd{w.wake[0], POLLIN, 0});
+            ids.clear();
+            for (auto& [id, c] : connections) {
+                short events = 0;
+                if (!c.waiting && !c.closing && !c.eof) events |= POLLIN;
+                if (!c.out.empty()) events |= POLLOUT;
+                fds.push_back({c.fd, events, 0});
+                ids.push_back(id);
+            }
+            if (::poll(fds.data(), fds.size(), -1) < 0) continue; // EINTR
+
+            if (fds[0].revents) {
+                char drain[256];
+                while (::read(w.wake[0], drain, sizeof drain) > 0) {
+                }
+                {
+                    std::lock_guard<std::mutex> lock(w.mutex);
+                    fresh.swap(w.newConnections);
+                    replies.swap(w.replies);
+                }
+                for (int fd : fresh) connections[nextId++].fd = fd;
+                for (auto& [id, reply] : replies) {
+                    auto it = connections.find(id);
+                    if (it == connections.end()) continue; // Closed while its edit was in flight
+                    it->second.out += reply;
+                    it->second.waiting = false;
+                    handleLines(index, id, it->second);
+                }
+                fresh.clear();
+                replies.clear();
+            }
+
+            for (size_t i = 1; i < fds.size(); ++i) {
+                auto it = connections.find(ids[i - 1]);
+                Connection& c = it->second;
+                bool open = !(fds[i].revents & (POLLERR | POLLNVAL));
+                if (open && (fds[i].revents & (POLLIN | POLLHUP))) open = receive(index, it->first, c);
+                if (open && !c.out.empty()) open = send(c);
+                if (!open || c.done()) {
+                    ::close(c.fd);
+                    connections.erase(it);
+                }
+            }
+        }
+        for (auto& [id, c] : connections) ::close(c.fd);
+    }
+
+    // Read what is available and handle complete lines. Reading pauses while
+    // an edit is in flight. Returns false on an over-long line.
+    bool receive(size_t worker, uint64_t id, Connection& c) {
+        char buf[1 << 14];
+        for (;;) {
+            ssize_t n = ::read(c.fd, buf, sizeof buf);
+            if (n > 0) {
+                c.in.append(buf, size_t(n));
+                handleLines(worker, id, c);
+                if (c.waiting || c.closing || c.in.size() > kMaxPending) break;
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n < 0 && errno == EINTR) continue;
+            c.eof = true; // Peer closed (or half-closed): answer what it sent, then close
+            if (!c.in.empty() && c.in.back() != '\n') c.in += '\n';
+            handleLines(worker, id, c);
+            break;
+        }
+        return c.in.find('\n') != std::string::npos || c.in.size() <= kMaxLine;
+    }
+
+    bool send(Connection& c) {
+        while (!c.out.empty()) {
+            ssize_t n = ::write(c.fd, c.out.data(), c.out.size());
+            if (n > 0) {
+                c.out.erase(0, size_t(n));
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            }
+        }
+        return true;
+    }
+
+    void handleLines(size_t worker, uint64_t id, Connection& c) {
+        while (!c.waiting && !c.closing) {
+            size_t nl = c.in.find('\n', c.consumed);
+            if (nl == std::string::npos) break;
+            std::string_view line(c.in.data() + c.consumed, nl - c.consumed);
+            c.consumed = nl + 1;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty()) continue;
+            size_t space = line.find(' ');
+            std::string_view command = line.substr(0, space);
+            std::string_view arg = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+
+            if (command == "QUIT") {
+                c.closing = true;
+            } else if (isEdit(command)) {
+                c.waiting = true;
+                {
+                    std::lock_guard<std::mutex> lock(editMutex_);
+                    edits_.push_back({worker, id, std::string(command), std::string(arg), std::string()});
+                }
+                editReady_.notify_one();
+            } else {
+                answer(worker, command, arg, c.out);
+            }
+        }
+        c.in.erase(0, c.consumed);
+        c.consumed = 0;
+    }
+
+    static bool isEdit(std::string_view command) {
+        return command == "ADD_CITY" || command == "ADD_ROAD" || command == "SET_BUDGET" || command == "EDIT" ||
+               command == "DELETE_CITY" || command == "DELETE_ROAD" || command == "LOCATE";
+    }
+
+    // Read queries against the pinned snapshot
+    void answer(size_t worker, std::string_view command, std::string_view arg, std::string& out) {
+        ScopedTimer timer(Metric::ServerRead);
+        EpochDomain::Guard guard(epochs_, worker);
+        const NetworkSnapshot& s = *current_.load();
+        auto lookup = [&](std::string_view name) { return s.cities.find(name); };
+        auto number = [&](double v) {
+            char buf[32];
+            out.append(buf, std::to_chars(buf, buf + sizeof buf, v, std::chars_format::fixed, 2).ptr);
+        };
+        int a = -1, b = -1;
+
+        if (command == "CITY") {
+            int index = s.cities.find(arg);
+            if (index == -1) out += "ERR unknown city";
+            else out += std::to_string(index + 1);
+        } else if (command == "NAME") {
+            uint32_t index = 0;
+            auto parsed = std::from_chars(arg.data(), arg.data() + arg.size(), index);
+            if (parsed.ptr != arg.data() + arg.size() || index == 0 || !s.cities.alive(index - 1)) out += "ERR no such index";
+            else out += s.cities[index - 1];
+        } else if (command == "INFO") {
+            out += "version " + std::to_string(s.version) + " cities " + std::to_string(s.cities.liveCount()) +
+                   " roads " + std::to_string(s.graph.roadCount());
+        } else if (command != "BUDGET" && command != "ROUTE" && command != "LINKED") {
+            out += "ERR unknown command";
+        } else if (!splitCityPair(arg, lookup, a, b)) {
+            out += "ERR unknown city";
+        } else if (command == "LINKED") {
+            out += s.group[a] == s.group[b] ? "yes" : "no";
+        } else if (command == "BUDGET") {
+            if (!s.graph.hasRoad(a, b)) out += "ERR no road between these cities";
+            else number(s.graph.getBudget(a, b));
+        } else { // ROUTE
+            RouteResult route;
+            if (s.group[a] == s.group[b]) route = workers_[worker]->planner.bidirectional(s.graph, a, b);
+            if (!route.found) {
+                out += "no route";
+            } else {
+                number(route.cost);
+                for (size_t i = 0; i < route.path.size(); ++i) {
+                    out += i ? " -> " : " via ";
+                    out += s.cities[route.path[i]];
+                }
+            }
+        }
+        out += '\n';
+    }
+
+    Apply apply_;
+    Build build_;
+    Commit commit_;
+    std::atomic<NetworkSnapshot*> current_{nullptr};
+    uint64_t version_ = 0; // Writer only
+    EpochDomain epochs_;   // One reader slot per worker
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::mutex editMutex_;
+    std::condition_variable editReady_;
+    std::vector<Edit> edits_;
+    std::atomic<bool> stopping_{false};
+
+    int listenFd_ = -1;
+    int stopPipe_[2] = {-1, -1};
+    std::string path_;
+};
+
+#endif // _WIN32
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>   // For sort, equal_range
+#include <cstdint>     // For the fixed-width on-disk fields
+#include <string>      // For paths and error messages
+#include <string_view> // For name lookups
+#include <vector>      // For assembling sections
+#include "mapped_file.h" // The index is read through a memory mapping
+#include "snapshot.h"    // Shards are snapshots; the index uses the same layout
+
+// Sharded storage of a network split into regions (--split-regions).
+//
+// Each region is an ordinary snapshot of its own cities and the roads between
+// them (network.region<N>.bin), so working on one region costs what a small
+// network costs. The index (network.regions) holds what ties them together,
+// in the snapshot layout with its own magic:
+//     kRegionTable   RegionEntry[regions]   checksum, cities and roads of each shard
+//     kBoundaryRoads BoundaryRoad[]         roads between two regions, by (region,
+//                                           position in its shard), from the lower region
+//     kRegionNames   RegionName[cities]     name hash -> (region, position), by hash
+//     kRegionSource  RegionSource           network.bin the regions were split from
+// A shard whose checksum differs from its table entry is not used, so a
+// shard and the index written by different runs are never mixed.
+
+struct RegionEntry {
+    uint64_t checksum; // Of the shard's snapshot
+    uint32_t cities;
+    uint32_t roads;    // Inside the region
+};
+
+struct BoundaryRoad {
+    uint32_t fromRegion; // fromRegion < toRegion
+    uint32_t fromCity;   // Position in its region's shard
+    uint32_t toRegion;
+    uint32_t toCity;
+    double budget;
+};
+
+struct RegionName {
+    uint64_t hash;   // regionNameHash() of the city name
+    uint32_t region;
+    uint32_t city;   // Position in the region's shard
+};
+
+struct RegionSource {
+    uint64_t snapshot; // Checksum of the network.bin the regions were split from
+    uint64_t edited;   // 1 once --edit-region has saved changes not yet in network.bin
+};
+
+static_assert(sizeof(RegionEntry) == 16, "region entry must stay 16 bytes");
+static_assert(sizeof(BoundaryRoad) == 24, "boundary road must stay 24 bytes");
+static_assert(sizeof(RegionName) == 16, "region name must stay 16 bytes");
+static_assert(sizeof(RegionSource) == 16, "region source must stay 16 bytes");
+
+const char kRegionIndexMagic[8] = {'R', 'B', 'P', 'R', 'E', 'G', 'N', '\0'};
+const uint32_t kRegionIndexVersion = 1;
+
+enum RegionSectionId : uint32_t {
+    kRegionTable = 1,
+    kBoundaryRoads = 2,
+    kRegionNames = 3,
+    kRegionSource = 4,
+};
+
+inline uint64_t regionNameHash(std::string_view name) { return snapshotChecksum(name.data(), name.size()); }
+
+inline bool operator<(const BoundaryRoad& a, const BoundaryRoad& b) {
+    if (a.fromRegion != b.fromRegion) return a.fromRegion < b.fromRegion;
+    if (a.fromCity != b.fromCity) return a.fromCity < b.fromCity;
+    return a.toRegion != b.toRegion ? a.toRegion < b.toRegion : a.toCity < b.toCity;
+}
+
+// Write the index; boundary and names are sorted first
+inline bool writeRegionIndex(const std::string& path, const std::vector<RegionEntry>& regions,
+                             std::vector<BoundaryRoad>& boundary, std::vector<RegionName>& names,
+                             RegionSource source) {
+    std::sort(boundary.begin(), boundary.end());
+    std::sort(names.begin(), names.end(), [](const RegionName& a, const RegionName& b) {
+        if (a.hash != b.hash) return a.hash < b.hash;
+        return a.region != b.region ? a.region < b.region : a.city < b.city;
+    });
+    const SectionData parts[] = {
+        {kRegionTable, regions.data(), regions.size() * sizeof(RegionEntry)},
+        {kBoundaryRoads, boundary.data(), boundary.size() * sizeof(BoundaryRoad)},
+        {kRegionNames, names.data(), names.size() * sizeof(RegionName)},
+        {kRegionSource, &source, sizeof source},
+    };
+    return writeSectionFile(path, kRegionIndexMagic, kRegionIndexVersion, parts, 4, nullptr);
+}
+
+// Validated, read-only view of a mapped network.regions
+class RegionIndex {
+public:
+    // Returns false (with a reason in error) if the file is missing, damaged
+    // or refers to regions it does not describe
+    bool open(const std::string& path, std::string& error) {
+        close();
+        bool ok = openSectionFile(file_, path, kRegionIndexMagic, kRegionIndexVersion, checksum_, error,
+                                  [&](uint32_t id, const char* data, uint64_t size) {
+            switch (id) {
+                case kRegionTable:
+                    regions_ = reinterpret_cast<const RegionEntry*>(data);
+                    regionCount_ = uint32_t(size / sizeof(RegionEntry));
+                    break;
+                case kBoundaryRoads:
+                    boundary_ = reinterpret_cast<const BoundaryRoad*>(data);
+                    boundaryCount_ = size / sizeof(BoundaryRoad);
+                    break;
+                case kRegionNames:
+                    names_ = reinterpret_cast<const RegionName*>(data);
+                    nameCount_ = size / sizeof(RegionName);
+                    break;
+                case kRegionSource:
+                    if (size != sizeof(RegionSource)) {
+                        error = "bad source section";
+                        return false;
+                    }
+                    source_ = reinterpret_cast<const RegionSource*>(data);
+                    break;
+                default:
+                    break; // Sections from newer writers are skipped
+            }
+            return true;
+        });
+        if (!ok) return false;
+        if (!regions_ || !boundary_ || !names_ || !source_) return fail(error, "missing section");
+        for (size_t i = 0; i < boundaryCount_; ++i) {
+            const BoundaryRoad& b = boundary_[i];
+            if (b.fromRegion >= b.toRegion || b.toRegion >= regionCount_ || b.fromCity >= regions_[b.fromRegion].cities ||
+                b.toCity >= regions_[b.toRegion].cities) {
+                return fail(error, "boundary road out of range");
+            }
+        }
+        for (size_t i = 0; i < nameCount_; ++i) {
+            if (names_[i].region >= regionCount_ || names_[i].city >= regions_[names_[i].region].cities) {
+                return fail(error, "name entry out of range");
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        file_.close();
+        regions_ = nullptr;
+        boundary_ = nullptr;
+        names_ = nullptr;
+        source_ = nullptr;
+        regionCount_ = 0;
+        boundaryCount_ = nameCount_ = 0;
+    }
+
+    bool isOpen() const { return regions_ != nullptr; }
+    uint32_t regionCount() const { return regionCount_; }
+    const RegionEntry& region(uint32_t r) const { return regions_[r]; }
+    size_t boundaryCount() const { return boundaryCount_; }
+    const BoundaryRoad* boundary() const { return boundary_; }
+    size_t nameCount() const { return nameCount_; }
+    const RegionName* names() const { return names_; }
+    const RegionSource& source() const { return *source_; }
+    uint64_t checksum() const { return checksum_; } // Of the whole file; names it in a region session's journal
+
+    // fn(region, position) for every city whose name has the hash of name
+    // (hash collisions included: the caller compares the names)
+    template <class Fn>
+    void forEachNamed(std::string_view name, Fn fn) const {
+        uint64_t h = regionNameHash(name);
+        const RegionName* first = std::lower_bound(names_, names_ + nameCount_, h,
+                                                   [](const RegionName& n, uint64_t v) { return n.hash < v; });
+        for (const RegionName* n = first; n < names_ + nameCount_ && n->hash == h; ++n) fn(n->region, n->city);
+    }
+
+private:
+    bool fail(std::string& error, const std::string& why) {
+        error = why;
+        close();
+        return false;
+    }
+
+    MappedFile file_;
+    const RegionEntry* regions_ = nullptr;
+    const BoundaryRoad* boundary_ = nullptr;
+    const RegionName* names_ = nullptr;
+    const RegionSource* source_ = nullptr;
+    uint32_t regionCount_ = 0;
+    size_t boundaryCount_ = 0;
+    size_t nameCount_ = 0;
+    uint64_t checksum_ = 0;
+};
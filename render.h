@@ -0,0 +1,207 @@
+#pragma once
+
+#include <algorithm>   // For lower_bound
+#include <charconv>    // For to_chars (fixed-point)
+#include <cmath>       // For isfinite, fabs
+#include <cstdint>     // For fixed-width integers
+#include <cstdio>      // For fwrite (non-POSIX fallback)
+#include <cstring>     // For memcpy, memset
+#include <iostream>    // To flush cout before writing around it
+#include <string_view> // For text fields
+#include <vector>      // For the reusable buffer
+#include "road_graph.h" // The road views walk its rows
+
+#ifdef _WIN32
+#include <io.h>     // For _write
+#else
+#include <unistd.h> // For write
+#endif
+
+// Console rendering buffer.
+//
+// Cells are formatted straight into one large reusable buffer with a
+// hand-rolled integer formatter and to_chars for fixed-point (no iostream
+// manipulators, no locale), and the buffer goes to the terminal in a single
+// write() when it fills up or when flush() is called. Field padding matches what "setw(w) << left" gave.
+// Output goes to stdout unless another file descriptor is given.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(size_t capacity = 1 << 20, int fd = 1) : limit_(capacity), fd_(fd) {
+        buf_.reserve(capacity + 256);
+    }
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer& text(std::string_view s) {
+        ensure(s.size());
+        buf_.insert(buf_.end(), s.begin(), s.end());
+        return *this;
+    }
+
+    OutputBuffer& ch(char c) {
+        ensure(1);
+        buf_.push_back(c);
+        return *this;
+    }
+
+    // Left-aligned text padded with spaces to width (longer text is kept whole)
+    OutputBuffer& field(std::string_view s, size_t width) {
+        text(s);
+        return pad(s.size(), width);
+    }
+
+    OutputBuffer& integer(uint64_t v) {
+        char tmp[20];
+        size_t n = formatUnsigned(tmp, v);
+        ensure(n);
+        buf_.insert(buf_.end(), tmp, tmp + n);
+        return *this;
+    }
+
+    OutputBuffer& integerField(uint64_t v, size_t width) {
+        char tmp[20];
+        size_t n = formatUnsigned(tmp, v);
+        text(std::string_view(tmp, n));
+        return pad(n, width);
+    }
+
+    // Fixed-point with the given number of decimals (0..6); non-finite
+    // values print as "-"
+    OutputBuffer& fixed(double v, int decimals) {
+        char tmp[40];
+        size_t n = formatFixed(tmp, v, decimals);
+        return text(std::string_view(tmp, n));
+    }
+
+    OutputBuffer& fixedField(double v, int decimals, size_t width) {
+        char tmp[40];
+        size_t n = formatFixed(tmp, v, decimals);
+        text(std::string_view(tmp, n));
+        return pad(n, width);
+    }
+
+    // Send everything buffered to the output with one write
+    void flush() {
+        if (buf_.empty()) return;
+        if (fd_ == 1) std::cout.flush(); // Keep ordering with earlier iostream output
+#ifndef _WIN32
+        const char* p = buf_.data();
+        size_t left = buf_.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd_, p, left);
+            if (n <= 0) break;
+            p += n;
+            left -= size_t(n);
+        }
+#else
+        if (fd_ == 1) {
+            fwrite(buf_.data(), 1, buf_.size(), stdout);
+            fflush(stdout);
+        } else {
+            _write(fd_, buf_.data(), unsigned(buf_.size()));
+        }
+#endif
+        buf_.clear();
+    }
+
+    static size_t formatUnsigned(char* out, uint64_t v) {
+        char rev[20];
+        size_t n = 0;
+        do {
+            rev[n++] = char('0' + v % 10);
+            v /= 10;
+        } while (v);
+        for (size_t i = 0; i < n; ++i) out[i] = rev[n - 1 - i];
+        return n;
+    }
+
+    static size_t formatFixed(char* out, double v, int decimals) {
+        if (!std::isfinite(v) || std::fabs(v) > 9e12) { // Out of fixed-point range
+            out[0] = '-';
+            return 1;
+        }
+        // Rounds the exact value of v, as "fixed << setprecision" does (2.675 is 2.67)
+        return size_t(std::to_chars(out, out + 32, v, std::chars_format::fixed, decimals).ptr - out);
+    }
+
+private:
+    OutputBuffer& pad(size_t used, size_t width) {
+        if (used < width) {
+            ensure(width - used);
+            buf_.insert(buf_.end(), width - used, ' ');
+        }
+        return *this;
+    }
+
+    void ensure(size_t more) {
+        if (buf_.size() + more > limit_) flush();
+    }
+
+    std::vector<char> buf_;
+    size_t limit_;
+    int fd_;
+};
+
+// Part of a matrix view: rows/columns are 0-based city indices, half-open
+struct MatrixWindow {
+    uint32_t rowBegin = 0, rowEnd = 0, colBegin = 0, colEnd = 0;
+};
+
+// One line per road in the roads.txt layout ("<nbr>. <A>-<B> <budget>"),
+// each road once, in (city, city) order. row() is called after every line
+// and returns false to stop.
+template <class NameOf, class Row>
+void renderRoadLines(OutputBuffer& out, RoadGraph& graph, NameOf nameOf, Row row) {
+    graph.compact();
+    uint64_t nbr = 1;
+    bool more = true;
+    for (uint32_t i = 0; i < graph.cityCount() && more; ++i) {
+        for (uint32_t s = graph.rowBegin(i), e = graph.rowEnd(i); s < e && more; ++s) {
+            uint32_t j = graph.colIndex[s];
+            if (j < i) continue; // Each road once
+            out.integer(nbr++).text(". ").text(nameOf(i)).ch('-').text(nameOf(j)).ch(' ');
+            out.fixed(graph.weight[s], 2).ch('\n');
+            more = row();
+        }
+    }
+}
+
+// Matrix over window: a header line of names cut to nameWidth, then one line
+// per city, its name and a cellWidth column per city. cell(slot) formats a
+// road (its slot in the graph's arrays) and cell(-1) a missing one. Cities
+// for which alive(i) is false get neither a row nor a column. row() is
+// called after every line and returns false to stop.
+template <class Alive, class NameOf, class Cell, class Row>
+void renderMatrix(OutputBuffer& out, RoadGraph& graph, const MatrixWindow& window, size_t cellWidth,
+                  size_t nameWidth, Alive alive, NameOf nameOf, Cell cell, Row row) {
+    out.field("", 15); // Space for row headers
+    for (uint32_t j = window.colBegin; j < window.colEnd; ++j) {
+        if (alive(j)) out.field(nameOf(j).substr(0, nameWidth), cellWidth); // Abbreviate city names
+    }
+    out.ch('\n');
+
+    graph.compact(); // Rows are walked in sorted neighbour order
+    for (uint32_t i = window.rowBegin; i < window.rowEnd; ++i) {
+        if (!alive(i)) continue;
+        out.field(nameOf(i), 15);
+        const uint32_t* cols = graph.colIndex.data();
+        uint32_t e = graph.rowEnd(i);
+        uint32_t s = uint32_t(std::lower_bound(cols + graph.rowBegin(i), cols + e, window.colBegin) - cols);
+        for (uint32_t j = window.colBegin; j < window.colEnd; ++j) {
+            if (!alive(j)) continue; // Has no roads, so s stays put
+            bool road = s < e && graph.colIndex[s] == j;
+            cell(road ? long(s) : -1L);
+            if (road) ++s;
+        }
+        out.ch('\n');
+        if (!row()) break;
+    }
+}
+
+// Budgets matrix: one decimal, missing roads as 0.0
+template <class Alive, class NameOf, class Row>
+void renderBudgetMatrix(OutputBuffer& out, RoadGraph& graph, const MatrixWindow& window, Alive alive, NameOf nameOf,
+                        Row row) {
+    renderMatrix(out, graph, window, 7, 5, alive, nameOf, [&](long slot) {
+        out.fixedField(slot != -1 ? graph.weight[slot] : 0.0, 1, 7);
+    }, row);
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <algorithm>     // For sort, lower_bound
+#include <cstdint>       // For fixed-width city ids
+#include <unordered_map> // For locating pending roads by city pair
+#include <utility>       // For pair
+#include <vector>        // For the CSR arrays and the delta buffer
+#include "parallel.h"    // For the parallel bulk merge
+
+// Sparse, undirected road network.
+//
+// Settled roads live in compressed sparse row (CSR) form: the neighbours of
+// city u are colIndex[rowStart[u] .. rowStop[u]), sorted by id, with the
+// budget of each road in the parallel weight array. Every road is stored in
+// both rows. Roads added since the last compaction sit in a small delta
+// buffer and are merged into the CSR arrays by compact(), which runs on its
+// own once the buffer grows past a fraction of the road count.
+//
+// Removing a road closes the gap inside its two CSR rows (O(degree)); the
+// freed slots at the row ends are squeezed out by the next compaction.
+//
+// Memory is O(cities + roads) instead of the O(cities^2) of an adjacency
+// matrix, and adding a city is O(1).
+struct RoadGraph {
+    struct Road {
+        uint32_t from;  // Smaller city id
+        uint32_t to;    // Larger city id
+        double budget;  // Budget in Billion Frw
+    };
+
+    std::vector<uint32_t> rowStart{0}; // CSR row offsets, one per compacted city plus one
+    std::vector<uint32_t> rowStop;     // End of each row's live slots (rowStart[u + 1] until roads are removed)
+    std::vector<uint32_t> colIndex;    // Neighbour ids, sorted within each row
+    std::vector<double> weight;        // Budget of each CSR slot
+    std::vector<Road> pending;         // Roads added since the last compaction
+    std::unordered_map<uint64_t, uint32_t> pendingSlot; // City pair -> position in pending
+    std::unordered_multimap<uint32_t, uint32_t> pendingByCity; // City -> positions in pending
+    uint32_t numCities = 0;
+    size_t numRoads = 0;
+    size_t holes = 0; // CSR slots freed by removeRoad() since the last compaction
+
+    static constexpr size_t kMinDeltaBeforeCompact = 1024;
+
+    static uint64_t pairKey(uint32_t u, uint32_t v) {
+        if (u > v) std::swap(u, v);
+        return (uint64_t(u) << 32) | v;
+    }
+
+    uint32_t cityCount() const { return numCities; }
+    size_t roadCount() const { return numRoads; }
+
+    // Make room for cities [0, n). Rows past the compacted range are empty.
+    void resize(uint32_t n) {
+        if (n > numCities) numCities = n;
+    }
+
+    uint32_t rowBegin(uint32_t u) const {
+        return u + 1 < rowStart.size() ? rowStart[u] : rowStart.back();
+    }
+    uint32_t rowEnd(uint32_t u) const {
+        return u + 1 < rowStart.size() ? rowStop[u] : rowStart.back();
+    }
+
+    // CSR slot holding road u->v, or -1 if it is not compacted yet (or absent)
+    long findSlot(uint32_t u, uint32_t v) const {
+        auto first = colIndex.begin() + rowBegin(u);
+        auto last = colIndex.begin() + rowEnd(u);
+        auto it = std::lower_bound(first, last, v);
+        if (it != last && *it == v) return long(it - colIndex.begin());
+        return -1;
+    }
+
+    bool hasRoad(uint32_t u, uint32_t v) const {
+        return findSlot(u, v) != -1 || pendingSlot.count(pairKey(u, v)) != 0;
+    }
+
+    // Returns false if the road already exists
+    bool addRoad(uint32_t u, uint32_t v, double budget = 0.0) {
+        if (u == v || u >= numCities || v >= numCities || hasRoad(u, v)) return false;
+        uint32_t slot = uint32_t(pending.size());
+        pendingSlot[pairKey(u, v)] = slot;
+        pendingByCity.emplace(u, slot);
+        pendingByCity.emplace(v, slot);
+        pending.push_back({std::min(u, v), std::max(u, v), budget});
+        ++numRoads;
+        if (pending.size() > std::max(kMinDeltaBeforeCompact, numRoads / 8)) compact();
+        return true;
+    }
+
+    // Returns false if there is no road between u and v
+    bool setBudget(uint32_t u, uint32_t v, double budget) {
+        long slot = findSlot(u, v);
+        if (slot != -1) {
+            weight[slot] = budget;
+            weight[findSlot(v, u)] = budget; // Keep both directions in sync
+            return true;
+        }
+        auto it = pendingSlot.find(pairKey(u, v));
+        if (it == pendingSlot.end()) return false;
+        pending[it->second].budget = budget;
+        return true;
+    }
+
+    double getBudget(uint32_t u, uint32_t v) const {
+        long slot = findSlot(u, v);
+        if (slot != -1) return weight[slot];
+        auto it = pendingSlot.find(pairKey(u, v));
+        return it == pendingSlot.end() ? 0.0 : pending[it->second].budget;
+    }
+
+    // Returns false if there is no such road. O(degree of u and v).
+    bool removeRoad(uint32_t u, uint32_t v) {
+        auto it = pendingSlot.find(pairKey(u, v));
+        if (it != pendingSlot.end()) {
+            erasePending(it->second);
+        } else {
+            long slot = findSlot(u, v);
+            if (slot == -1) return false;
+            eraseFromRow(u, uint32_t(slot));
+            eraseFromRow(v, uint32_t(findSlot(v, u)));
+            holes += 2;
+        }
+        --numRoads;
+        if (holes > std::max(kMinDeltaBeforeCompact, colIndex.size() / 4)) compact();
+        return true;
+    }
+
+    // Remove every road touching u; returns how many there were
+    size_t removeRoadsOf(uint32_t u) {
+        std::vector<uint32_t> neighbours;
+        forEachNeighbor(u, [&](uint32_t v, double) { neighbours.push_back(v); });
+        for (uint32_t v : neighbours) removeRoad(u, v);
+        return neighbours.size();
+    }
+
+    // Give city u the id newId[u]. Cities mapped to an id >= count are
+    // dropped and must have no roads. Ids that keep their relative order are
+    // remapped in place; any other order moves every row.
+    void renumber(const std::vector<uint32_t>& newId, uint32_t count) {
+        compact();
+        for (uint32_t u = 0, last = 0; u < numCities; ++u) {
+            if (newId[u] >= count) continue;
+            if (newId[u] < last) return permute(newId, count);
+            last = newId[u];
+        }
+        std::vector<uint32_t> start(size_t(count) + 1, 0);
+        for (uint32_t u = 0; u < numCities; ++u) {
+            if (newId[u] < count) start[newId[u]] = rowStart[u];
+        }
+        start[count] = rowStart.back();
+        for (uint32_t& v : colIndex) v = newId[v]; // Order-preserving, so rows stay sorted
+        rowStart.swap(start);
+        rowStop.assign(rowStart.begin() + 1, rowStart.end());
+        numCities = count;
+    }
+
+    // Add many roads at once (e.g. when loading a file): one sort and one merge
+    // instead of a hash lookup per road. Self-loops and unknown cities are
+    // dropped; for duplicate roads the last budget wins.
+    void addRoadsBulk(const std::vector<Road>& roads) {
+        pending.reserve(pending.size() + roads.size());
+        for (const Road& r : roads) {
+            if (r.from == r.to || r.from >= numCities || r.to >= numCities) continue;
+            pending.push_back({std::min(r.from, r.to), std::max(r.from, r.to), r.budget});
+        }
+        compact();
+    }
+
+    // Merge the delta buffer into the CSR arrays and cover every city with a row
+    void compact() {
+        if (pending.empty() && holes == 0 && rowStart.size() == size_t(numCities) + 1) return;
+
+        // Both directions of every pending road, grouped by source row
+        std::vector<Road> delta;
+        delta.reserve(pending.size() * 2);
+        for (const Road& r : pending) {
+            delta.push_back(r);
+            delta.push_back({r.to, r.from, r.budget});
+        }
+        std::stable_sort(delta.begin(), delta.end(), bySource);
+
+        std::vector<uint32_t> newStart(size_t(numCities) + 1);
+        std::vector<uint32_t> newCol;
+        std::vector<double> newWeight;
+        newCol.reserve(colIndex.size() + delta.size());
+        newWeight.reserve(colIndex.size() + delta.size());
+
+        size_t d = 0;
+        for (uint32_t u = 0; u < numCities; ++u) {
+            newStart[u] = uint32_t(newCol.size());
+            mergeRow(u, delta, d, newCol, newWeight);
+        }
+        newStart[numCities] = uint32_t(newCol.size());
+        install(newStart, newCol, newWeight);
+    }
+
+    // Parallel addRoadsBulk() for very large imports. parts are consecutive
+    // pieces of the input in input order (e.g. one per parsing thread), so
+    // the last budget of a duplicate road still wins. Every part is sorted on
+    // its own thread, then slices of rows with similar numbers of roads are
+    // merged (the parts' runs with each other, then with the CSR arrays) on
+    // separate threads and copied into place.
+    // The parts are consumed.
+    void addRoadsBulk(std::vector<std::vector<Road>>& parts) {
+        compact();
+        const uint32_t n = numCities;
+        std::vector<std::vector<Road>> directed(parts.size()); // Both directions, sorted by (from, to)
+        parallelFor(parts.size(), [&](size_t begin, size_t end, unsigned) {
+            for (size_t k = begin; k < end; ++k) {
+                std::vector<Road>& out = directed[k];
+                out.reserve(parts[k].size() * 2);
+                for (const Road& r : parts[k]) {
+                    if (r.from == r.to || r.from >= n || r.to >= n) continue;
+                    out.push_back(r);
+                    out.push_back({r.to, r.from, r.budget});
+                }
+                std::vector<Road>().swap(parts[k]);
+                radixSortBySource(out, n);
+            }
+        }, 1);
+
+        std::vector<uint32_t> bounds = sliceRows(directed, workerCount() * 4);
+        const size_t slices = bounds.size() - 1;
+        std::vector<std::vector<uint32_t>> sliceCol(slices);
+        std::vector<std::vector<double>> sliceWeight(slices);
+        std::vector<uint32_t> newStart(size_t(n) + 1);
+        parallelFor(slices, [&](size_t begin, size_t end, unsigned) {
+            std::vector<Road> delta;
+            std::vector<size_t> runs; // Start of each part's entries in delta, then its end
+            for (size_t k = begin; k < end; ++k) {
+                const uint32_t lo = bounds[k], hi = bounds[k + 1];
+                delta.clear();
+                runs.assign(1, 0);
+                for (const std::vector<Road>& part : directed) { // In input order
+                    auto first = std::lower_bound(part.begin(), part.end(), lo, sourceBelow);
+                    auto last = std::lower_bound(first, part.end(), hi, sourceBelow);
+                    delta.insert(delta.end(), first, last);
+                    runs.push_back(delta.size());
+                }
+                // Merge neighbouring sorted runs pairwise; earlier runs win ties
+                for (size_t width = 1; width + 1 < runs.size(); width *= 2) {
+                    for (size_t r = 0; r + width + 1 < runs.size(); r += 2 * width) {
+                        size_t last = std::min(r + 2 * width, runs.size() - 1);
+                        std::inplace_merge(delta.begin() + runs[r], delta.begin() + runs[r + width],
+                                           delta.begin() + runs[last], bySource);
+                    }
+                }
+                size_t d = 0;
+                for (uint32_t u = lo; u < hi; ++u) {
+                    newStart[u] = uint32_t(sliceCol[k].size()); // Relative to the slice for now
+                    mergeRow(u, delta, d, sliceCol[k], sliceWeight[k]);
+                }
+            }
+        }, 1);
+        directed.clear();
+
+        std::vector<size_t> offset(slices + 1, 0);
+        for (size_t k = 0; k < slices; ++k) offset[k + 1] = offset[k] + sliceCol[k].size();
+        std::vector<uint32_t> newCol(offset[slices]);
+        std::vector<double> newWeight(offset[slices]);
+        parallelFor(slices, [&](size_t begin, size_t end, unsigned) {
+            for (size_t k = begin; k < end; ++k) {
+                for (uint32_t u = bounds[k]; u < bounds[k + 1]; ++u) newStart[u] += uint32_t(offset[k]);
+                std::copy(sliceCol[k].begin(), sliceCol[k].end(), newCol.begin() + offset[k]);
+                std::copy(sliceWeight[k].begin(), sliceWeight[k].end(), newWeight.begin() + offset[k]);
+                std::vector<uint32_t>().swap(sliceCol[k]);
+                std::vector<double>().swap(sliceWeight[k]);
+            }
+        }, 1);
+        newStart[n] = uint32_t(newCol.size());
+        install(newStart, newCol, newWeight);
+    }
+
+    // Visit (neighbour, budget) for every road touching u. Pending roads are
+    // found through pendingByCity, so this is O(degree) even before compaction.
+    template <class Fn>
+    void forEachNeighbor(uint32_t u, Fn fn) const {
+        for (uint32_t s = rowBegin(u), e = rowEnd(u); s < e; ++s) fn(colIndex[s], weight[s]);
+        if (pendingByCity.empty()) return;
+        auto range = pendingByCity.equal_range(u);
+        for (auto it = range.first; it != range.second; ++it) {
+            const Road& r = pending[it->second];
+            fn(r.from == u ? r.to : r.from, r.budget);
+        }
+    }
+
+    // Visit (u, v, budget) once per road with u < v. Roads come out ordered
+    // by (u, v) when the graph is compacted.
+    template <class Fn>
+    void forEachRoad(Fn fn) const {
+        for (uint32_t u = 0; u + 1 < rowStart.size(); ++u) {
+            for (uint32_t s = rowStart[u], e = rowStop[u]; s < e; ++s) {
+                if (colIndex[s] > u) fn(u, colIndex[s], weight[s]);
+            }
+        }
+        for (const Road& r : pending) fn(r.from, r.to, r.budget);
+    }
+
+private:
+    static bool bySource(const Road& a, const Road& b) {
+        return a.from != b.from ? a.from < b.from : a.to < b.to;
+    }
+    static bool sourceBelow(const Road& r, uint32_t u) { return r.from < u; }
+
+    // Sort by (from, to) with two stable counting passes (by to, then by
+    // from), so duplicates keep their input order. Both ends are below n.
+    static void radixSortBySource(std::vector<Road>& roads, uint32_t n) {
+        std::vector<Road> scratch(roads.size());
+        std::vector<size_t> next(size_t(n) + 1);
+        auto pass = [&](std::vector<Road>& from, std::vector<Road>& to, uint32_t Road::*key) {
+            std::fill(next.begin(), next.end(), 0);
+            for (const Road& r : from) ++next[r.*key + 1];
+            for (size_t i = 1; i <= n; ++i) next[i] += next[i - 1];
+            for (const Road& r : from) to[next[r.*key]++] = r;
+        };
+        pass(roads, scratch, &Road::to);
+        pass(scratch, roads, &Road::from);
+    }
+
+    // Append row u of the CSR arrays to col/w, merged with the entries of
+    // delta from d on whose source is u (sorted by target). The delta wins
+    // over the CSR arrays, and the last of equal delta entries wins.
+    void mergeRow(uint32_t u, const std::vector<Road>& delta, size_t& d, std::vector<uint32_t>& col,
+                  std::vector<double>& w) const {
+        const size_t first = col.size();
+        uint32_t s = rowBegin(u), e = rowEnd(u);
+        while (s < e || (d < delta.size() && delta[d].from == u)) {
+            bool takeOld = d >= delta.size() || delta[d].from != u || (s < e && colIndex[s] < delta[d].to);
+            if (takeOld) {
+                col.push_back(colIndex[s]);
+                w.push_back(weight[s]);
+                ++s;
+                continue;
+            }
+            if (s < e && colIndex[s] == delta[d].to) ++s; // Bulk-loaded duplicate of a settled road
+            if (col.size() > first && col.back() == delta[d].to) {
+                w.back() = delta[d].budget; // Duplicate within the delta: last one wins
+            } else {
+                col.push_back(delta[d].to);
+                w.push_back(delta[d].budget);
+            }
+            ++d;
+        }
+    }
+
+    // Row boundaries 0 = b[0] < ... < b[k] = numCities splitting the settled
+    // and new entries into about `slices` equal parts, from a sample of both
+    std::vector<uint32_t> sliceRows(const std::vector<std::vector<Road>>& directed, size_t slices) const {
+        size_t total = colIndex.size();
+        for (const auto& part : directed) total += part.size();
+        const size_t step = std::max<size_t>(1, total / (slices * 64));
+        std::vector<uint32_t> sample;
+        for (size_t s = 0; s < colIndex.size(); s += step) {
+            sample.push_back(uint32_t(std::upper_bound(rowStart.begin(), rowStart.end(), uint32_t(s)) - rowStart.begin() - 1));
+        }
+        for (const auto& part : directed) {
+            for (size_t s = 0; s < part.size(); s += step) sample.push_back(part[s].from);
+        }
+        std::sort(sample.begin(), sample.end());
+        std::vector<uint32_t> bounds{0};
+        for (size_t k = 1; k < slices && !sample.empty(); ++k) {
+            uint32_t b = sample[k * sample.size() / slices];
+            if (b > bounds.back() && b < numCities) bounds.push_back(b);
+        }
+        bounds.push_back(numCities);
+        return bounds;
+    }
+
+    void install(std::vector<uint32_t>& newStart, std::vector<uint32_t>& newCol, std::vector<double>& newWeight) {
+        rowStart.swap(newStart);
+        rowStop.assign(rowStart.begin() + 1, rowStart.end());
+        colIndex.swap(newCol);
+        weight.swap(newWeight);
+        holes = 0;
+        pending.clear();
+        pendingSlot.clear();
+        pendingByCity.clear();
+        numRoads = colIndex.size() / 2;
+    }
+
+    // renumber() for ids in any order: copy each row to its new place, then
+    // sort it by the new neighbour ids
+    void permute(const std::vector<uint32_t>& newId, uint32_t count) {
+        std::vector<uint32_t> start(size_t(count) + 1, 0);
+        for (uint32_t u = 0; u < numCities; ++u) {
+            if (newId[u] < count) start[newId[u] + 1] = rowEnd(u) - rowBegin(u);
+        }
+        for (uint32_t v = 0; v < count; ++v) start[v + 1] += start[v];
+        std::vector<uint32_t> newCol(start[count]);
+        std::vector<double> newWeight(start[count]);
+        std::vector<std::pair<uint32_t, double>> row;
+        for (uint32_t u = 0; u < numCities; ++u) {
+            if (newId[u] >= count) continue;
+            row.clear();
+            for (uint32_t s = rowBegin(u), e = rowEnd(u); s < e; ++s) row.push_back({newId[colIndex[s]], weight[s]});
+            std::sort(row.begin(), row.end());
+            uint32_t s = start[newId[u]];
+            for (const auto& r : row) {
+                newCol[s] = r.first;
+                newWeight[s++] = r.second;
+            }
+        }
+        numCities = count;
+        install(start, newCol, newWeight);
+    }
+
+    // Close the gap at CSR slot s of row u
+    void eraseFromRow(uint32_t u, uint32_t s) {
+        uint32_t e = rowStop[u]--;
+        std::copy(colIndex.begin() + s + 1, colIndex.begin() + e, colIndex.begin() + s);
+        std::copy(weight.begin() + s + 1, weight.begin() + e, weight.begin() + s);
+    }
+
+    // Drop pending road `slot`, moving the last pending road into its place
+    void erasePending(uint32_t slot) {
+        auto relink = [&](uint32_t city, uint32_t from, uint32_t to) { // to == kNone unlinks
+            auto range = pendingByCity.equal_range(city);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second != from) continue;
+                if (to == kNone) pendingByCity.erase(it);
+                else it->second = to;
+                return;
+            }
+        };
+        const Road gone = pending[slot];
+        pendingSlot.erase(pairKey(gone.from, gone.to));
+        relink(gone.from, slot, kNone);
+        relink(gone.to, slot, kNone);
+        uint32_t last = uint32_t(pending.size() - 1);
+        if (slot != last) {
+            const Road moved = pending[last];
+            pending[slot] = moved;
+            pendingSlot[pairKey(moved.from, moved.to)] = slot;
+            relink(moved.from, last, slot);
+            relink(moved.to, last, slot);
+        }
+        pending.pop_back();
+    }
+
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+};
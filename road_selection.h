@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm> // For sort, upper_bound
+#include <chrono>    // For the search deadline
+#include <cstdint>   // For fixed-width ids
+#include <mutex>     // For publishing the best selection
+#include <queue>     // For the lazy greedy heap
+#include <random>    // For moves and restarts
+#include <utility>   // For pair
+#include <vector>    // For candidates and selections
+#include "parallel.h"   // For parallelFor, workerCount
+#include "road_graph.h" // Candidates are roads of the graph
+
+// Budget-constrained road selection: which of the candidate roads to build
+// with a fixed budget, to either
+//   - link as many pairs of cities as possible (two cities are linked when
+//     the selected roads connect them), or
+//   - cover as much priority as possible (a city counts once a selected road
+//     touches it; each city has a priority weight).
+// Both are NP-hard, so the search starts from a greedy selection (cheapest
+// roads joining two groups first, or the best priority per budget first)
+// and refines it with local search: drop a few random roads, refill the
+// budget with the best of a random sample of affordable roads, keep the
+// result if it is better. Every worker thread searches on its own, with
+// randomized restarts when it stops improving, and the best selection of
+// all is published through a callback as soon as it is found.
+class RoadSelector {
+public:
+    enum Objective { LinkPairs, CoverCities };
+
+    struct Selection {
+        std::vector<RoadGraph::Road> roads;
+        double cost = 0.0;
+        double score = 0.0; // Linked pairs, or covered priority
+    };
+
+    // candidates: roads that may be built, with their budget as the cost.
+    // weight[c]: priority of city c (CoverCities only).
+    RoadSelector(std::vector<RoadGraph::Road> candidates, uint32_t cityCount, std::vector<double> weight = {})
+        : roads_(std::move(candidates)), cityCount_(cityCount), weight_(std::move(weight)) {
+        std::sort(roads_.begin(), roads_.end(), [](const RoadGraph::Road& x, const RoadGraph::Road& y) {
+            if (x.budget != y.budget) return x.budget < y.budget;
+            return x.from != y.from ? x.from < y.from : x.to < y.to;
+        });
+        cost_.reserve(roads_.size());
+        for (const RoadGraph::Road& r : roads_) cost_.push_back(r.budget);
+        weight_.resize(cityCount_, 0.0);
+    }
+
+    size_t candidateCount() const { return roads_.size(); }
+
+    // Search for `seconds` on `threads` workers. onImprove(const Selection&,
+    // double elapsedSeconds) is called (one call at a time) every time a
+    // better selection is found. Returns the best one.
+    template <class OnImprove>
+    Selection run(Objective objective, double budget, double seconds, OnImprove onImprove,
+                  unsigned threads = workerCount(), uint64_t seed = 1) {
+        objective_ = objective;
+        budget_ = budget;
+        best_ = Selection();
+        bestScore_ = -1.0;
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                    std::chrono::duration<double>(seconds));
+        std::mutex lock;
+        auto publish = [&](const Search& s) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!better(s.score, s.cost, bestScore_, best_.cost)) return;
+            bestScore_ = s.score;
+            bestChosen_ = s.chosen;
+            best_.roads.clear();
+            for (uint32_t i : s.chosen) best_.roads.push_back(roads_[i]);
+            best_.cost = s.cost;
+            best_.score = s.score;
+            onImprove(best_, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        };
+        auto bestChosen = [&](Search& s) {
+            std::lock_guard<std::mutex> guard(lock);
+            s.load(bestChosen_);
+        };
+
+        parallelFor(std::max(1u, threads), [&](size_t begin, size_t end, unsigned) {
+            for (size_t worker = begin; worker < end; ++worker) {
+                Search s(*this, seed + worker);
+                s.greedy(worker != 0); // Worker 0 starts from the plain greedy selection
+                publish(s);
+                for (uint32_t stall = 0, round = 0; std::chrono::steady_clock::now() < deadline; ++round) {
+                    if (s.improve()) {
+                        stall = 0;
+                        publish(s);
+                    } else if (++stall >= kStallRounds) { // Restart: alternately a random greedy or the best so far
+                        if (round % 2) s.greedy(true);
+                        else bestChosen(s);
+                        stall = 0;
+                    }
+                }
+            }
+        }, 1);
+        return best_;
+    }
+
+private:
+    static constexpr uint32_t kSample = 32;         // Affordable roads looked at per refill step
+    static constexpr uint32_t kStallRounds = 2000;  // Rounds without progress before a restart
+
+    // Higher score wins; at equal score the cheaper selection
+    static bool better(double score, double cost, double bestScore, double bestCost) {
+        double eps = 1e-9 * std::max(1.0, std::abs(bestScore));
+        return score > bestScore + eps || (score > bestScore - eps && cost < bestCost - 1e-9);
+    }
+
+    // One worker's current selection, with the group (LinkPairs) or cover
+    // count (CoverCities) of every city. Per-city arrays are reset lazily
+    // through a generation stamp, so a rebuild costs O(selected roads).
+    struct Search {
+        const RoadSelector& owner;
+        std::mt19937_64 rng;
+        std::vector<uint32_t> chosen;   // Candidate indices
+        std::vector<char> in;           // Candidate index -> selected
+        std::vector<uint32_t> parent, size, stamp, cover;
+        uint32_t generation = 1;
+        double cost = 0.0, score = 0.0;
+
+        Search(const RoadSelector& o, uint64_t seed)
+            : owner(o), rng(seed), in(o.roads_.size(), 0), parent(o.cityCount_), size(o.cityCount_),
+              stamp(o.cityCount_, 0), cover(o.cityCount_) {}
+
+        uint32_t find(uint32_t x) {
+            if (stamp[x] != generation) {
+                stamp[x] = generation;
+                parent[x] = x;
+                size[x] = 1;
+                cover[x] = 0;
+            }
+            while (parent[x] != x) {
+                parent[x] = parent[parent[x]]; // Path halving (parents are always stamped)
+                x = parent[x];
+            }
+            return x;
+        }
+
+        // Score added by selecting candidate i
+        double gain(uint32_t i) {
+            const RoadGraph::Road& r = owner.roads_[i];
+            if (owner.objective_ == CoverCities) {
+                find(r.from);
+                find(r.to);
+                return (cover[r.from] ? 0.0 : owner.weight_[r.from]) + (cover[r.to] ? 0.0 : owner.weight_[r.to]);
+            }
+            uint32_t a = find(r.from), b = find(r.to);
+            return a == b ? 0.0 : double(size[a]) * double(size[b]);
+        }
+
+        void add(uint32_t i) {
+            const RoadGraph::Road& r = owner.roads_[i];
+            score += gain(i);
+            cost += owner.cost_[i];
+            in[i] = 1;
+            chosen.push_back(i);
+            if (owner.objective_ == CoverCities) {
+                ++cover[r.from];
+                ++cover[r.to];
+                return;
+            }
+            uint32_t a = find(r.from), b = find(r.to);
+            if (a == b) return;
+            if (size[a] < size[b]) std::swap(a, b);
+            parent[b] = a;
+            size[a] += size[b];
+        }
+
+        // Replace the selection with another list of candidates
+        void load(const std::vector<uint32_t>& selection) {
+            for (uint32_t i : chosen) in[i] = 0;
+            chosen.clear();
+            ++generation;
+            cost = score = 0.0;
+            for (uint32_t i : selection) add(i);
+        }
+
+        // Greedy selection within the budget. LinkPairs: cheapest roads that
+        // join two groups first (Kruskal). CoverCities: best priority per
+        // budget first, with gains refreshed lazily (they only shrink).
+        // Randomized: costs are scaled by a random factor in [1, 1.5).
+        void greedy(bool randomized) {
+            load({});
+            std::uniform_real_distribution<double> noise(1.0, 1.5);
+            const size_t m = owner.roads_.size();
+            std::vector<std::pair<double, uint32_t>> order; // (key, candidate)
+            order.reserve(m);
+            for (uint32_t i = 0; i < m; ++i) {
+                double c = owner.cost_[i] * (randomized ? noise(rng) : 1.0);
+                double key = owner.objective_ == CoverCities ? -gain(i) / std::max(c, 1e-12) : c;
+                order.push_back({key, i});
+            }
+            if (owner.objective_ == LinkPairs) {
+                if (randomized) std::sort(order.begin(), order.end());
+                for (const auto& o : order) {
+                    if (cost + owner.cost_[o.second] <= owner.budget_ && gain(o.second) > 0) add(o.second);
+                }
+                return;
+            }
+            std::priority_queue<std::pair<double, uint32_t>> heap; // (gain per cost, candidate)
+            for (const auto& o : order) {
+                if (o.first < 0) heap.push({-o.first, o.second});
+            }
+            while (!heap.empty()) {
+                auto top = heap.top();
+                heap.pop();
+                uint32_t i = top.second;
+                if (cost + owner.cost_[i] > owner.budget_) continue;
+                double ratio = gain(i) / std::max(owner.cost_[i], 1e-12);
+                if (ratio <= 0) continue;
+                if (!heap.empty() && ratio < heap.top().first) {
+                    heap.push({ratio, i}); // Stale: try again with the fresh gain
+                    continue;
+                }
+                add(i);
+            }
+        }
+
+        // One local search round: drop 1-3 random roads, refill with the best
+        // of random affordable samples, and keep the change only if it is
+        // better. Returns true if it was.
+        bool improve() {
+            std::vector<uint32_t> before = chosen;
+            double beforeScore = score, beforeCost = cost;
+            if (!chosen.empty()) {
+                uint32_t drop = 1 + uint32_t(rng() % 3);
+                std::vector<uint32_t> kept = chosen;
+                for (uint32_t d = 0; d < drop && !kept.empty(); ++d) {
+                    size_t at = rng() % kept.size();
+                    kept[at] = kept.back();
+                    kept.pop_back();
+                }
+                load(kept);
+            }
+            refill();
+            if (better(score, cost, beforeScore, beforeCost)) return true;
+            load(before);
+            return false;
+        }
+
+        void refill() {
+            for (;;) {
+                double left = owner.budget_ - cost;
+                size_t affordable = size_t(std::upper_bound(owner.cost_.begin(), owner.cost_.end(), left) -
+                                           owner.cost_.begin());
+                if (affordable == 0) return;
+                uint32_t pick = 0;
+                double pickRatio = 0.0;
+                for (uint32_t k = 0; k < kSample; ++k) {
+                    uint32_t i = uint32_t(rng() % affordable);
+                    if (in[i]) continue;
+                    double ratio = gain(i) / std::max(owner.cost_[i], 1e-12);
+                    if (ratio > pickRatio) {
+                        pick = i;
+                        pickRatio = ratio;
+                    }
+                }
+                if (pickRatio <= 0) return;
+                add(pick);
+            }
+        }
+    };
+
+    std::vector<RoadGraph::Road> roads_; // Candidates by cost
+    std::vector<double> cost_;           // roads_[i].budget, for binary search
+    uint32_t cityCount_;
+    std::vector<double> weight_;
+    Objective objective_ = LinkPairs;
+    double budget_ = 0.0;
+    Selection best_;
+    double bestScore_ = -1.0;
+    std::vector<uint32_t> bestChosen_;   // Candidate indices of best_
+};
@@ -6,27 +6,19 @@
 #include <iomanip>  // For formatting output (setw, fixed, setprecision)
 #include <map>      // For mapping city names to their numerical indices
 #include <limits>   // For numeric_limits (clearing input buffer)
+#include "road_graph.h" // Sparse CSR road network
 
 using namespace std;
 // Global data structures for easy access across functions
 std::vector<std::string> cities;                   // Stores city names, index + 1 is city ID
 std::map<std::string, int> cityNameToIndex;        // Maps city name to its 0-based index
-std::vector<std::vector<int>> roadsMatrix;         // Adjacency matrix for roads (0 or 1)
-std::vector<std::vector<double>> budgetMatrix;     // Adjacency matrix for road budgets
+RoadGraph roadGraph;                     // Sparse road network with budgets
 
 // --- Helper Functions ---
 
-// Function to resize matrices when a new city is added
-void resizeMatrices() {
-    int newSize = cities.size();
-    roadsMatrix.resize(newSize, std::vector<int>(newSize, 0));
-    budgetMatrix.resize(newSize, std::vector<double>(newSize, 0.0));
-
-    // Re-initialize new rows/cols to 0 (important if growing existing)
-    for (int i = 0; i < newSize; ++i) {
-        roadsMatrix[i].resize(newSize, 0);
-        budgetMatrix[i].resize(newSize, 0.0);
-    }
+// Function to grow the road graph when a new city is added (O(1), no matrix rows to touch)
+void resizeRoadGraph() {
+    roadGraph.resize(cities.size());
 }
 
 // Get city index by name
@@ -61,14 +53,11 @@ void saveRoadsToFile() {
     }
     outFile << "Nbr Road Budget\n"; // Header
     int road_nbr = 1;
-    for (size_t i = 0; i < cities.size(); ++i) {
-        for (size_t j = i + 1; j < cities.size(); ++j) { // Only half matrix
-            if (roadsMatrix[i][j] == 1) {
-                outFile << road_nbr++ << ". " << cities[i] << "-" << cities[j]
-                        << " " << std::fixed << std::setprecision(2) << budgetMatrix[i][j] << "\n";
-            }
-        }
-    }
+    roadGraph.compact(); // Roads come out in (city, city) order once compacted
+    roadGraph.forEachRoad([&](uint32_t i, uint32_t j, double budget) { // Each road once
+        outFile << road_nbr++ << ". " << cities[i] << "-" << cities[j]
+                << " " << std::fixed << std::setprecision(2) << budget << "\n";
+    });
     outFile.close();
     std::cout << "Roads and budgets saved to roads.txt.\n";
 }
@@ -100,7 +89,7 @@ void addNewCities() {
 
         cities.push_back(cityName);
         cityNameToIndex[cityName] = cities.size() - 1; // Map new city to its index
-        resizeMatrices(); // Resize matrices for new city
+        resizeRoadGraph(); // Make room for the new city in the road graph
         std::cout << "City '" << cityName << "' added with index " << cities.size() << ".\n";
     }
     saveCitiesToFile(); // Save after adding cities
@@ -118,8 +107,7 @@ void addRoads() {
     int idx2 = getCityIndex(city2Name);
 
     if (idx1 != -1 && idx2 != -1 && idx1 != idx2) {
-        roadsMatrix[idx1][idx2] = 1;
-        roadsMatrix[idx2][idx1] = 1; // Roads are bidirectional
+        roadGraph.addRoad(idx1, idx2); // Roads are bidirectional
         std::cout << "Road added between " << city1Name << " and " << city2Name << ".\n";
     } else {
         std::cout << "Error: One or both cities not found, or same city.\n";
@@ -140,7 +128,7 @@ void addBudgetForRoads() {
     int idx2 = getCityIndex(city2Name);
 
     if (idx1 != -1 && idx2 != -1 && idx1 != idx2) {
-        if (roadsMatrix[idx1][idx2] == 1) { // Check if road exists
+        if (roadGraph.hasRoad(idx1, idx2)) { // Check if road exists
             std::cout << "Enter the budget for the road (in Billion Frw): ";
             while (!(std::cin >> budget) || budget < 0) {
                 std::cout << "Invalid input. Please enter a non-negative number: ";
@@ -149,8 +137,7 @@ void addBudgetForRoads() {
             }
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Clear buffer
 
-            budgetMatrix[idx1][idx2] = budget;
-            budgetMatrix[idx2][idx1] = budget; // Budget is bidirectional
+            roadGraph.setBudget(idx1, idx2, budget); // Budget is bidirectional
             std::cout << "Budget added for the road between " << city1Name << " and " << city2Name << ".\n";
         } else {
             std::cout << "Error: No road exists between " << city1Name << " and " << city2Name << ".\n";
@@ -225,10 +212,14 @@ void displayRoadsMatrix() {
     }
     std::cout << "\n";
 
-    for (size_t i = 0; i < roadsMatrix.size(); ++i) {
+    roadGraph.compact(); // Rows are walked in sorted neighbour order
+    for (uint32_t i = 0; i < cities.size(); ++i) {
         std::cout << std::setw(15) << std::left << cities[i];
-        for (size_t j = 0; j < roadsMatrix[i].size(); ++j) {
-            std::cout << std::setw(3) << roadsMatrix[i][j];
+        uint32_t s = roadGraph.rowBegin(i), e = roadGraph.rowEnd(i);
+        for (uint32_t j = 0; j < cities.size(); ++j) {
+            bool road = s < e && roadGraph.colIndex[s] == j;
+            if (road) ++s;
+            std::cout << std::setw(3) << (road ? 1 : 0);
         }
         std::cout << "\n";
     }
@@ -251,10 +242,14 @@ void displayAllData() {
     }
     std::cout << "\n";
 
-    for (size_t i = 0; i < budgetMatrix.size(); ++i) {
+    roadGraph.compact();
+    for (uint32_t i = 0; i < cities.size(); ++i) {
         std::cout << std::setw(15) << std::left << cities[i];
-        for (size_t j = 0; j < budgetMatrix[i].size(); ++j) {
-            std::cout << std::setw(7) << std::fixed << std::setprecision(1) << budgetMatrix[i][j];
+        uint32_t s = roadGraph.rowBegin(i), e = roadGraph.rowEnd(i);
+        for (uint32_t j = 0; j < cities.size(); ++j) {
+            double budget = 0.0; // Missing roads show as 0.0, as before
+            if (s < e && roadGraph.colIndex[s] == j) budget = roadGraph.weight[s++];
+            std::cout << std::setw(7) << std::fixed << std::setprecision(1) << budget;
         }
         std::cout << "\n";
     }
@@ -284,7 +279,7 @@ int main() {
     // Initial setup with predefined cities (Menu 1 will add them dynamically)
     // cities = {"Kigali", "Huye", "Muhanga", "Musanze", "Nyagatare", "Rubavu", "Rusizi"};
     // for(size_t i=0; i<cities.size(); ++i) cityNameToIndex[cities[i]] = i;
-    // resizeMatrices(); // Initialize matrices for existing cities
+    // resizeRoadGraph(); // Initialize the road graph for existing cities
 
     int choice;
     do {
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm> // For reverse
+#include <cstdint>   // For fixed-width ids and keys
+#include <cstring>   // For memcpy
+#include <limits>    // For infinity
+#include <vector>    // For buckets, labels and paths
+#include "road_graph.h" // Routes run over the sparse road graph
+
+// Cheapest-route queries over road budgets.
+//
+// Budgets are non-negative, so Dijkstra's extracted keys never decrease and a
+// radix heap can replace a binary heap: each item moves down through at most
+// 65 buckets over its lifetime. Per-city labels are stamped with a query
+// number instead of being reset, so a query only touches the cities it
+// actually reaches. Compacting the graph first keeps every neighbour scan on
+// the contiguous CSR rows.
+
+struct RouteResult {
+    bool found = false;
+    double cost = 0.0;           // Total budget along the route
+    std::vector<uint32_t> path;  // City ids from source to target
+    size_t settled = 0;          // Cities taken off the heap (search effort)
+};
+
+// Monotone priority queue keyed by non-negative doubles
+class RadixHeap {
+public:
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    void clear() {
+        for (auto& b : buckets_) b.clear();
+        size_ = 0;
+        last_ = 0;
+    }
+
+    // key must be >= the last key popped (rounding slack is clamped)
+    void push(double key, uint32_t value) {
+        uint64_t k = std::max(bits(key), last_);
+        buckets_[bucketOf(k)].push_back({k, value});
+        ++size_;
+    }
+
+    double topKey() {
+        refill();
+        return fromBits(buckets_[0].back().key);
+    }
+
+    uint32_t pop(double& key) {
+        refill();
+        Item item = buckets_[0].back();
+        buckets_[0].pop_back();
+        --size_;
+        key = fromBits(item.key);
+        return item.value;
+    }
+
+private:
+    struct Item {
+        uint64_t key;
+        uint32_t value;
+    };
+
+    // For non-negative doubles the IEEE bit pattern orders like the value
+    static uint64_t bits(double d) {
+        uint64_t u;
+        std::memcpy(&u, &d, sizeof u);
+        return u;
+    }
+    static double fromBits(uint64_t u) {
+        double d;
+        std::memcpy(&d, &u, sizeof d);
+        return d;
+    }
+
+    size_t bucketOf(uint64_t k) const {
+        uint64_t diff = k ^ last_;
+        return diff == 0 ? 0 : 64 - size_t(__builtin_clzll(diff));
+    }
+
+    // Make bucket 0 non-empty by redistributing the lowest non-empty bucket
+    void refill() {
+        if (!buckets_[0].empty()) return;
+        size_t i = 1;
+        while (buckets_[i].empty()) ++i;
+        uint64_t minKey = buckets_[i][0].key;
+        for (const Item& item : buckets_[i]) minKey = std::min(minKey, item.key);
+        last_ = minKey;
+        for (const Item& item : buckets_[i]) buckets_[bucketOf(item.key)].push_back(item);
+        buckets_[i].clear();
+    }
+
+    std::vector<Item> buckets_[65];
+    size_t size_ = 0;
+    uint64_t last_ = 0;
+};
+
+class RoutePlanner {
+public:
+    // A* search. heuristic(u) must never overestimate the cheapest cost from u
+    // to target (and be consistent), otherwise the route may not be optimal.
+    template <class Heuristic>
+    RouteResult astar(const RoadGraph& graph, uint32_t source, uint32_t target, Heuristic heuristic) {
+        RouteResult result;
+        begin(graph.cityCount());
+        Side& f = sides_[0];
+        f.heap.clear();
+        reach(f, source, 0.0, source);
+        f.heap.push(heuristic(source), source);
+        while (!f.heap.empty()) {
+            double key;
+            uint32_t u = f.heap.pop(key);
+            Label& lu = f.labels[u];
+            if (lu.settled == stamp_) continue; // Stale heap entry
+            lu.settled = stamp_;
+            ++result.settled;
+            if (u == target) break;
+            graph.forEachNeighbor(u, [&](uint32_t v, double budget) {
+                double d = lu.dist + budget;
+                Label& lv = f.labels[v];
+                if (lv.seen != stamp_ || d < lv.dist) {
+                    reach(f, v, d, u);
+                    f.heap.push(d + heuristic(v), v);
+                }
+            });
+        }
+        if (f.labels[target].seen == stamp_) finish(result, target, f.labels[target].dist, source);
+        return result;
+    }
+
+    // Bidirectional Dijkstra: grow a search from each end and stop once the
+    // two frontiers can no longer improve the best meeting point found
+    RouteResult bidirectional(const RoadGraph& graph, uint32_t source, uint32_t target) {
+        RouteResult result;
+        begin(graph.cityCount());
+        for (Side& side : sides_) side.heap.clear();
+        reach(sides_[0], source, 0.0, source);
+        sides_[0].heap.push(0.0, source);
+        reach(sides_[1], target, 0.0, target);
+        sides_[1].heap.push(0.0, target);
+
+        double best = std::numeric_limits<double>::infinity();
+        uint32_t meet = source;
+        bool met = source == target;
+        if (met) best = 0.0;
+        while (!sides_[0].heap.empty() && !sides_[1].heap.empty()) {
+            double top0 = sides_[0].heap.topKey(), top1 = sides_[1].heap.topKey();
+            if (top0 + top1 >= best) break;
+            int dir = top0 <= top1 ? 0 : 1; // Expand the cheaper frontier
+            Side& me = sides_[dir];
+            Side& other = sides_[1 - dir];
+            double key;
+            uint32_t u = me.heap.pop(key);
+            Label& lu = me.labels[u];
+            if (lu.settled == stamp_) continue;
+            lu.settled = stamp_;
+            ++result.settled;
+            graph.forEachNeighbor(u, [&](uint32_t v, double budget) {
+                double d = lu.dist + budget;
+                Label& lv = me.labels[v];
+                if (lv.seen != stamp_ || d < lv.dist) {
+                    reach(me, v, d, u);
+                    me.heap.push(d, v);
+                }
+                const Label& ov = other.labels[v];
+                if (ov.seen == stamp_ && me.labels[v].dist + ov.dist < best) {
+                    best = me.labels[v].dist + ov.dist;
+                    meet = v;
+                    met = true;
+                }
+            });
+        }
+        if (!met) return result;
+
+        finish(result, meet, best, source);       // source .. meet
+        for (uint32_t v = meet; v != target;) {   // meet .. target via the backward tree
+            v = sides_[1].labels[v].parent;
+            result.path.push_back(v);
+        }
+        return result;
+    }
+
+private:
+    struct Label {
+        double dist = 0.0;
+        uint32_t parent = 0;
+        uint32_t seen = 0;    // Query stamp when dist was last set
+        uint32_t settled = 0; // Query stamp when the city was settled
+    };
+    struct Side {
+        std::vector<Label> labels;
+        RadixHeap heap;
+    };
+
+    // Start a query: new stamp, labels sized to the graph
+    void begin(uint32_t cityCount) {
+        for (Side& side : sides_) {
+            if (side.labels.size() < cityCount) side.labels.resize(cityCount);
+        }
+        if (++stamp_ == 0) { // Stamp wrapped: clear stale stamps once
+            for (Side& side : sides_) side.labels.assign(side.labels.size(), Label());
+            stamp_ = 1;
+        }
+    }
+
+    void reach(Side& side, uint32_t v, double dist, uint32_t parent) {
+        Label& l = side.labels[v];
+        l.dist = dist;
+        l.parent = parent;
+        l.seen = stamp_;
+    }
+
+    // Fill in cost and the forward path source .. end
+    void finish(RouteResult& result, uint32_t end, double cost, uint32_t source) {
+        result.found = true;
+        result.cost = cost;
+        for (uint32_t v = end;; v = sides_[0].labels[v].parent) {
+            result.path.push_back(v);
+            if (v == source) break;
+        }
+        std::reverse(result.path.begin(), result.path.end());
+    }
+
+    Side sides_[2];
+    uint32_t stamp_ = 0;
+};
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>     // For the fixed-width on-disk fields
+#include <cstdio>      // For FILE-based writing
+#include <cstring>     // For memcpy, memcmp
+#include <string>      // For paths and error messages
+#include <string_view> // For city names inside the mapping
+#include <vector>      // For assembling sections
+#include "mapped_file.h" // Snapshots are read through a memory mapping
+#include "road_graph.h"  // Roads come from / go into the sparse graph
+#include "spatial_index.h" // For city locations
+
+// Binary snapshot of the road network (network.bin).
+//
+// Layout (little-endian, every section 8-byte aligned):
+//     SnapshotHeader                      magic, version, section count, checksum
+//     SnapshotSection[sectionCount]       id, offset, size of each section
+//     sections...
+// Sections:
+//     kCityOffsets  uint32_t[cities + 1]  start of each name in kCityNames
+//     kCityNames    char[]                all names back to back, no separators
+//     kRoads        SnapshotRoad[roads]   (from < to, budget), sorted by (from, to)
+//     kCityPoints   SnapshotPoint[cities] latitude, longitude (NaN: unknown);
+//                                         only written once a city is located
+//     kDeletedCities uint32_t[]           indices of deleted cities, stored with
+//                                         empty names; only written while there
+//                                         are gaps in the index range
+// The checksum covers everything after the header. Because the arrays are
+// stored exactly as they are used, a mapped snapshot can be read in place
+// through SnapshotView without decoding.
+
+struct SnapshotHeader {
+    char magic[8];         // "RBPSNAP" plus a terminating zero
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t checksum;     // snapshotChecksum() of the bytes after the header
+};
+
+struct SnapshotSection {
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset;       // From the start of the file
+    uint64_t size;         // In bytes
+};
+
+struct SnapshotRoad {
+    uint32_t from;
+    uint32_t to;
+    double budget;
+};
+
+struct SnapshotPoint {
+    double lat;
+    double lon;
+};
+
+static_assert(sizeof(SnapshotHeader) == 24, "snapshot header must stay 24 bytes");
+static_assert(sizeof(SnapshotSection) == 24, "snapshot section entry must stay 24 bytes");
+static_assert(sizeof(SnapshotRoad) == 16, "snapshot road must stay 16 bytes");
+static_assert(sizeof(SnapshotPoint) == 16, "snapshot point must stay 16 bytes");
+
+const char kSnapshotMagic[8] = {'R', 'B', 'P', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t kSnapshotVersion = 1;
+
+enum SnapshotSectionId : uint32_t {
+    kCityOffsets = 1,
+    kCityNames = 2,
+    kRoads = 3,
+    kCityPoints = 4,
+    kDeletedCities = 5,
+};
+
+// 64-bit checksum that consumes eight bytes per step
+inline uint64_t snapshotChecksum(const char* data, size_t size) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+    }
+    for (; i < size; ++i) h = (h ^ uint8_t(data[i])) * 0x100000001B3ull;
+    return h ^ (h >> 29);
+}
+
+// One section to be written by writeSectionFile()
+struct SectionData {
+    uint32_t id;
+    const void* data;
+    size_t size;
+};
+
+// Write a file in the snapshot layout (header with magic and version, the
+// section index, then the 8-byte aligned sections) and return the body
+// checksum through *checksum
+inline bool writeSectionFile(const std::string& path, const char* magic, uint32_t version,
+                             const SectionData* parts, uint32_t count, uint64_t* checksum) {
+    // Lay the sections out after the index, then checksum the whole body
+    std::vector<char> body(count * sizeof(SnapshotSection));
+    for (uint32_t i = 0; i < count; ++i) {
+        body.resize((body.size() + 7) & ~size_t(7)); // 8-byte alignment
+        SnapshotSection sec{parts[i].id, 0, sizeof(SnapshotHeader) + body.size(), parts[i].size};
+        std::memcpy(body.data() + i * sizeof(SnapshotSection), &sec, sizeof sec);
+        const char* src = static_cast<const char*>(parts[i].data);
+        body.insert(body.end(), src, src + parts[i].size);
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, magic, sizeof header.magic);
+    header.version = version;
+    header.sectionCount = count;
+    header.checksum = snapshotChecksum(body.data(), body.size());
+    if (checksum) *checksum = header.checksum;
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&header, sizeof header, 1, f) == 1 &&
+              fwrite(body.data(), 1, body.size(), f) == body.size();
+    return fclose(f) == 0 && ok;
+}
+
+// Map a file written by writeSectionFile() and check its magic, version and
+// checksum. Calls onSection(id, data, size) for every section, which returns
+// false (with a reason in error) to reject the file. On failure the file is
+// closed and error says why.
+template <class OnSection>
+bool openSectionFile(MappedFile& file, const std::string& path, const char* magic, uint32_t version,
+                     uint64_t& checksum, std::string& error, OnSection onSection) {
+    auto fail = [&](const std::string& why) {
+        error = why;
+        file.close();
+        return false;
+    };
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const char* base = file.begin();
+    size_t size = file.size();
+    SnapshotHeader header;
+    if (size < sizeof header) return fail("file too short");
+    std::memcpy(&header, base, sizeof header);
+    if (std::memcmp(header.magic, magic, sizeof header.magic) != 0) return fail("wrong file type");
+    if (header.version != version) return fail("unsupported version " + std::to_string(header.version));
+    if (snapshotChecksum(base + sizeof header, size - sizeof header) != header.checksum) return fail("checksum mismatch");
+    checksum = header.checksum;
+    if (size - sizeof header < header.sectionCount * sizeof(SnapshotSection)) return fail("truncated section index");
+
+    for (uint32_t i = 0; i < header.sectionCount; ++i) {
+        SnapshotSection sec;
+        std::memcpy(&sec, base + sizeof header + i * sizeof sec, sizeof sec);
+        if (sec.offset > size || sec.size > size - sec.offset) return fail("section out of bounds");
+        if (!onSection(sec.id, base + sec.offset, sec.size)) return fail(error);
+    }
+    return true;
+}
+
+// Write a snapshot of cityCount cities (names from nameOf(i)) and every road
+// of graph. The graph is compacted first so roads come out sorted. Cities
+// keep their indices; deleted lists the deleted ones among them, whose names
+// must be empty and which must have no roads. The body checksum goes to
+// *checksum. locations[i] is the location of city i (missing entries are
+// unknown).
+template <class NameOf>
+bool writeSnapshot(const std::string& path, uint32_t cityCount, NameOf nameOf, RoadGraph& graph,
+                   const std::vector<uint32_t>& deleted = {}, uint64_t* checksum = nullptr,
+                   const std::vector<GeoPoint>& locations = {}) {
+    graph.compact();
+
+    std::vector<uint32_t> offsets;
+    offsets.reserve(size_t(cityCount) + 1);
+    std::string names;
+    std::vector<SnapshotPoint> points;
+    bool located = false;
+    for (uint32_t i = 0; i < cityCount; ++i) {
+        offsets.push_back(uint32_t(names.size()));
+        names += nameOf(i);
+        GeoPoint p = i < locations.size() ? locations[i] : GeoPoint();
+        points.push_back({p.lat, p.lon});
+        located |= p.known();
+    }
+    offsets.push_back(uint32_t(names.size()));
+    if (!located) points.clear(); // Keep the section out of networks without locations
+
+    std::vector<SnapshotRoad> roads;
+    roads.reserve(graph.roadCount());
+    graph.forEachRoad([&](uint32_t a, uint32_t b, double budget) { roads.push_back({a, b, budget}); });
+
+    SectionData parts[5] = {
+        {kCityOffsets, offsets.data(), offsets.size() * sizeof(uint32_t)},
+        {kCityNames, names.data(), names.size()},
+        {kRoads, roads.data(), roads.size() * sizeof(SnapshotRoad)},
+    };
+    uint32_t count = 3;
+    if (located) parts[count++] = {kCityPoints, points.data(), points.size() * sizeof(SnapshotPoint)};
+    if (!deleted.empty()) parts[count++] = {kDeletedCities, deleted.data(), deleted.size() * sizeof(uint32_t)};
+    return writeSectionFile(path, kSnapshotMagic, kSnapshotVersion, parts, count, checksum);
+}
+
+// Validated, read-only view of a mapped snapshot
+class SnapshotView {
+public:
+    // Returns false (with a reason in error) if the file is missing, truncated,
+    // of another version or fails its checksum
+    bool open(const std::string& path, std::string& error) {
+        bool ok = openSectionFile(file_, path, kSnapshotMagic, kSnapshotVersion, checksum_, error,
+                                  [&](uint32_t id, const char* data, uint64_t size) {
+            switch (id) {
+                case kCityOffsets:
+                    if (size < sizeof(uint32_t)) {
+                        error = "empty name offsets";
+                        return false;
+                    }
+                    offsets_ = reinterpret_cast<const uint32_t*>(data);
+                    cityCount_ = uint32_t(size / 4 - 1);
+                    break;
+                case kCityNames:
+                    names_ = data;
+                    namesSize_ = size;
+                    break;
+                case kRoads:
+                    roads_ = reinterpret_cast<const SnapshotRoad*>(data);
+                    roadCount_ = size / sizeof(SnapshotRoad);
+                    break;
+                case kCityPoints:
+                    points_ = reinterpret_cast<const SnapshotPoint*>(data);
+                    pointsSize_ = size;
+                    break;
+                case kDeletedCities:
+                    deleted_ = reinterpret_cast<const uint32_t*>(data);
+                    deletedCount_ = size / sizeof(uint32_t);
+                    break;
+                default:
+                    break; // Sections from newer writers are skipped
+            }
+            return true;
+        });
+        if (!ok) return false;
+        if (!offsets_ || !names_ || !roads_) return fail(error, "missing section");
+        for (uint32_t i = 0; i < cityCount_; ++i) {
+            if (offsets_[i] > offsets_[i + 1]) return fail(error, "name table out of order");
+        }
+        if (offsets_[cityCount_] > namesSize_) return fail(error, "name table out of bounds");
+        if (points_ && pointsSize_ != cityCount_ * sizeof(SnapshotPoint)) return fail(error, "location table size mismatch");
+        for (size_t i = 0; i < deletedCount_; ++i) {
+            if (deleted_[i] >= cityCount_ || !cityName(deleted_[i]).empty()) return fail(error, "bad deleted city");
+        }
+        return true;
+    }
+
+    uint64_t checksum() const { return checksum_; }
+    uint32_t cityCount() const { return cityCount_; }
+    std::string_view cityName(uint32_t i) const {
+        return std::string_view(names_ + offsets_[i], offsets_[i + 1] - offsets_[i]);
+    }
+    size_t roadCount() const { return roadCount_; }
+    const SnapshotRoad* roads() const { return roads_; }
+    const SnapshotPoint* points() const { return points_; } // One per city, or null if none is located
+    size_t deletedCount() const { return deletedCount_; }
+    const uint32_t* deleted() const { return deleted_; }    // Indices of the gaps left by deleted cities
+
+private:
+    bool fail(std::string& error, const std::string& why) {
+        error = why;
+        file_.close();
+        return false;
+    }
+
+    MappedFile file_;
+    const uint32_t* offsets_ = nullptr;
+    const char* names_ = nullptr;
+    size_t namesSize_ = 0;
+    const SnapshotRoad* roads_ = nullptr;
+    const SnapshotPoint* points_ = nullptr;
+    size_t pointsSize_ = 0;
+    const uint32_t* deleted_ = nullptr;
+    size_t deletedCount_ = 0;
+    uint32_t cityCount_ = 0;
+    size_t roadCount_ = 0;
+    uint64_t checksum_ = 0;
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm> // For nth_element, sort
+#include <cmath>     // For trigonometry and NaN
+#include <cstdint>   // For fixed-width ids and Hilbert keys
+#include <limits>    // For quiet_NaN
+#include <queue>     // For the nearest-N heap
+#include <utility>   // For pair
+#include <vector>    // For the tree arrays
+
+// Latitude/longitude of a city in degrees; NaN while unknown
+struct GeoPoint {
+    double lat = std::numeric_limits<double>::quiet_NaN();
+    double lon = std::numeric_limits<double>::quiet_NaN();
+
+    bool known() const { return !std::isnan(lat) && !std::isnan(lon); }
+    static bool valid(double lat, double lon) { return lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180; }
+};
+
+const double kEarthRadiusKm = 6371.0088; // Mean radius
+const double kDegrees = 3.14159265358979323846 / 180; // Radians per degree
+
+// Great-circle distance in km (haversine)
+inline double distanceKm(GeoPoint a, GeoPoint b) {
+    double dLat = (b.lat - a.lat) * kDegrees, dLon = (b.lon - a.lon) * kDegrees;
+    double h = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(a.lat * kDegrees) * std::cos(b.lat * kDegrees) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2 * kEarthRadiusKm * std::asin(std::sqrt(std::min(1.0, h)));
+}
+
+// Position of p along a Hilbert curve through a 65536 x 65536 lat/lon grid:
+// points close on the map mostly get close keys
+inline uint32_t hilbertKey(GeoPoint p) {
+    const uint32_t n = 1u << 16;
+    uint32_t x = uint32_t(std::min((p.lon + 180) / 360 * n, double(n - 1)));
+    uint32_t y = uint32_t(std::min((p.lat + 90) / 180 * n, double(n - 1)));
+    uint32_t key = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) ? 1 : 0, ry = (y & s) ? 1 : 0;
+        key += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) { // Rotate the quadrant so the curve stays continuous
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+    }
+    return key;
+}
+
+// Old id -> new id putting the located cities (alive(i) true) in Hilbert
+// order, followed by the other live cities in their current order. Cities
+// that are not alive map to 0xFFFFFFFF.
+template <class Alive>
+std::vector<uint32_t> hilbertMapping(const std::vector<GeoPoint>& points, uint32_t count, Alive alive) {
+    std::vector<std::pair<uint32_t, uint32_t>> located; // (key, id)
+    std::vector<uint32_t> rest;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!alive(i)) continue;
+        if (i < points.size() && points[i].known()) located.push_back({hilbertKey(points[i]), i});
+        else rest.push_back(i);
+    }
+    std::sort(located.begin(), located.end());
+    std::vector<uint32_t> newId(count, 0xFFFFFFFFu);
+    uint32_t next = 0;
+    for (const auto& l : located) newId[l.second] = next++;
+    for (uint32_t i : rest) newId[i] = next++;
+    return newId;
+}
+
+// Static k-d tree over the located cities, for nearest-N, radius and
+// bounding-box queries.
+//
+// Points are stored as unit vectors, where straight-line (chord) distance
+// grows with great-circle distance, so nearest and radius searches prune
+// exactly by splitting plane, with no trouble at the poles or the date line.
+// The tree is implicit: the median of each range is its node, split along
+// the range's widest axis. Each node also keeps the lat/lon bounds of its
+// subtree, which is what bounding-box queries prune on. Build O(n log n);
+// queries visit O(log n) nodes plus the ones reported.
+class SpatialIndex {
+public:
+    // Index every known point; ids are positions in points
+    void build(const std::vector<GeoPoint>& points) {
+        items_.clear();
+        for (uint32_t i = 0; i < points.size(); ++i) {
+            if (!points[i].known()) continue;
+            Item item;
+            item.id = i;
+            item.where = points[i];
+            toUnit(points[i], item.xyz);
+            items_.push_back(item);
+        }
+        build(0, items_.size());
+        stale_ = false;
+    }
+
+    void invalidate() { stale_ = true; }
+    bool stale() const { return stale_; }
+    size_t size() const { return items_.size(); }
+
+    // The count located cities nearest to p as (id, km), nearest first
+    std::vector<std::pair<uint32_t, double>> nearest(GeoPoint p, size_t count) const {
+        std::priority_queue<std::pair<double, uint32_t>> best; // (chord², item), farthest on top
+        if (count > 0) {
+            double q[3];
+            toUnit(p, q);
+            nearest(0, items_.size(), q, count, best);
+        }
+        std::vector<std::pair<uint32_t, double>> out(best.size());
+        for (size_t i = out.size(); i-- > 0; best.pop()) {
+            const Item& item = items_[best.top().second];
+            out[i] = {item.id, distanceKm(p, item.where)};
+        }
+        return out;
+    }
+
+    // Located cities within km of p as (id, km), nearest first
+    std::vector<std::pair<uint32_t, double>> within(GeoPoint p, double km) const {
+        std::vector<std::pair<uint32_t, double>> out;
+        double angle = std::min(km / kEarthRadiusKm, 180 * kDegrees);
+        double chord = 2 * std::sin(angle / 2);
+        double q[3];
+        toUnit(p, q);
+        within(0, items_.size(), q, chord * chord * (1 + 1e-12), out);
+        for (auto& o : out) { // Item -> (id, km)
+            o.second = distanceKm(p, items_[o.first].where);
+            o.first = items_[o.first].id;
+        }
+        std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+        return out;
+    }
+
+    // Located cities with south <= lat <= north and west <= lon <= east
+    // (west > east: the box crosses the date line), in tree order
+    std::vector<uint32_t> inBox(double south, double west, double north, double east) const {
+        std::vector<uint32_t> out;
+        Bounds box{south, north, west, east};
+        inBox(0, items_.size(), box, out);
+        return out;
+    }
+
+private:
+    struct Bounds {
+        double minLat, maxLat, minLon, maxLon;
+    };
+    struct Item {
+        uint32_t id;
+        uint8_t axis;  // Split axis of the subtree this item is the median of
+        GeoPoint where;
+        double xyz[3];
+        Bounds bounds; // Lat/lon extent of that subtree
+    };
+
+    static void toUnit(GeoPoint p, double* xyz) {
+        double lat = p.lat * kDegrees, lon = p.lon * kDegrees;
+        xyz[0] = std::cos(lat) * std::cos(lon);
+        xyz[1] = std::cos(lat) * std::sin(lon);
+        xyz[2] = std::sin(lat);
+    }
+
+    static double chord2(const double* a, const double* b) {
+        double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    void build(size_t lo, size_t hi) {
+        if (lo >= hi) return;
+        double low[3] = {2, 2, 2}, high[3] = {-2, -2, -2};
+        Bounds b{90, -90, 180, -180};
+        for (size_t i = lo; i < hi; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                low[k] = std::min(low[k], items_[i].xyz[k]);
+                high[k] = std::max(high[k], items_[i].xyz[k]);
+            }
+            b.minLat = std::min(b.minLat, items_[i].where.lat);
+            b.maxLat = std::max(b.maxLat, items_[i].where.lat);
+            b.minLon = std::min(b.minLon, items_[i].where.lon);
+            b.maxLon = std::max(b.maxLon, items_[i].where.lon);
+        }
+        uint8_t axis = 0;
+        for (uint8_t k = 1; k < 3; ++k) {
+            if (high[k] - low[k] > high[axis] - low[axis]) axis = k;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        std::nth_element(items_.begin() + lo, items_.begin() + mid, items_.begin() + hi,
+                         [axis](const Item& a, const Item& c) { return a.xyz[axis] < c.xyz[axis]; });
+        items_[mid].axis = axis;
+        items_[mid].bounds = b;
+        build(lo, mid);
+        build(mid + 1, hi);
+    }
+
+    void nearest(size_t lo, size_t hi, const double* q, size_t count,
+                 std::priority_queue<std::pair<double, uint32_t>>& best) const {
+        if (lo >= hi) return;
+        size_t mid = lo + (hi - lo) / 2;
+        const Item& node = items_[mid];
+        double d = chord2(q, node.xyz);
+        if (best.size() < count) best.push({d, uint32_t(mid)});
+        else if (d < best.top().first) {
+            best.pop();
+            best.push({d, uint32_t(mid)});
+        }
+        double plane = q[node.axis] - node.xyz[node.axis];
+        bool leftFirst = plane < 0;
+        nearest(leftFirst ? lo : mid + 1, leftFirst ? mid : hi, q, count, best);
+        if (best.size() < count || plane * plane < best.top().first) {
+            nearest(leftFirst ? mid + 1 : lo, leftFirst ? hi : mid, q, count, best);
+        }
+    }
+
+    void within(size_t lo, size_t hi, const double* q, double radius2,
+                std::vector<std::pair<uint32_t, double>>& out) const {
+        if (lo >= hi) return;
+        size_t mid = lo + (hi - lo) / 2;
+        const Item& node = items_[mid];
+        if (chord2(q, node.xyz) <= radius2) out.push_back({uint32_t(mid), 0.0});
+        double plane = q[node.axis] - node.xyz[node.axis];
+        if (plane < 0 || plane * plane <= radius2) within(lo, mid, q, radius2, out);
+        if (plane > 0 || plane * plane <= radius2) within(mid + 1, hi, q, radius2, out);
+    }
+
+    static bool lonOverlaps(const Bounds& box, double minLon, double maxLon) {
+        if (box.minLon <= box.maxLon) return minLon <= box.maxLon && maxLon >= box.minLon;
+        return maxLon >= box.minLon || minLon <= box.maxLon; // [minLon, 180] or [-180, maxLon]
+    }
+
+    static bool contains(const Bounds& box, GeoPoint p) {
+        return p.lat >= box.minLat && p.lat <= box.maxLat && lonOverlaps(box, p.lon, p.lon);
+    }
+
+    void inBox(size_t lo, size_t hi, const Bounds& box, std::vector<uint32_t>& out) const {
+        if (lo >= hi) return;
+        size_t mid = lo + (hi - lo) / 2;
+        const Bounds& b = items_[mid].bounds;
+        if (b.maxLat < box.minLat || b.minLat > box.maxLat || !lonOverlaps(box, b.minLon, b.maxLon)) return;
+        if (contains(box, items_[mid].where)) out.push_back(items_[mid].id);
+        inBox(lo, mid, box, out);
+        inBox(mid + 1, hi, box, out);
+    }
+
+    std::vector<Item> items_; // Implicit tree: the median of each range is its root
+    bool stale_ = true;
+};
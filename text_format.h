@@ -0,0 +1,177 @@
+#pragma once
+
+#include <charconv>    // For from_chars
+#include <cstring>     // For memchr
+#include <iomanip>     // For fixed, setprecision
+#include <limits>      // For quiet_NaN (unknown locations)
+#include <ostream>     // For writing roads.txt
+#include <string_view> // For zero-copy fields
+#include "road_graph.h"
+
+// In-place parsers for the cities.txt and roads.txt interchange files. They
+// walk a raw character range (typically a MappedFile) and hand string_views
+// into it to callbacks, so no line is copied into a std::string. The
+// roads.txt writer lives here too, next to the parser that reads it back.
+
+// cities.txt header when the lines carry locations
+const char* const kLocatedCitiesHeader = "Index Cityname Latitude Longitude";
+
+// Next line of [p, end) without its "\n" or "\r\n"; advances p past it
+inline std::string_view nextLine(const char*& p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+    const char* lineEnd = nl ? nl : end;
+    std::string_view line(p, size_t(lineEnd - p));
+    p = nl ? nl + 1 : end;
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1); // Files saved on Windows
+    return line;
+}
+
+// Split "<CityA>-<CityB>" into two city indices. City names may themselves
+// contain '-', so every '-' is tried as the separator until lookup
+// (std::string_view -> index or -1) resolves both sides.
+template <class Lookup>
+bool splitCityPair(std::string_view pair, Lookup lookup, int& a, int& b) {
+    for (size_t dash = pair.find('-'); dash != std::string_view::npos; dash = pair.find('-', dash + 1)) {
+        a = lookup(pair.substr(0, dash));
+        b = a == -1 ? -1 : lookup(pair.substr(dash + 1));
+        if (b != -1) return true;
+    }
+    return false;
+}
+
+struct ParseStats {
+    size_t parsed = 0;  // Records handed to the callback
+    size_t skipped = 0; // Malformed lines or unknown cities
+};
+
+// Take a trailing " <lat> <lon>" off line. "-" stands for an unknown value
+// and comes back as NaN. Returns false if the two fields are missing or
+// are not numbers.
+inline bool splitLocation(std::string_view& line, double& lat, double& lon) {
+    double* out[2] = {&lon, &lat};
+    for (double* value : out) {
+        size_t space = line.rfind(' ');
+        if (space == std::string_view::npos) return false;
+        std::string_view field = line.substr(space + 1);
+        if (field == "-") {
+            *value = std::numeric_limits<double>::quiet_NaN();
+        } else if (std::from_chars(field.data(), field.data() + field.size(), *value).ptr != field.data() + field.size()) {
+            return false;
+        }
+        line = line.substr(0, space);
+    }
+    return true;
+}
+
+// cities.txt: "Index Cityname" header, then "<index> <name>" per line; or
+// "Index Cityname Latitude Longitude", then "<index> <name> <lat> <lon>"
+// ("- -" when unknown). bool addCity(std::string_view name, double lat,
+// double lon) is called once per city, in file order, with NaN for unknown
+// values; it returns false for a name it already has, and that line counts
+// as skipped.
+template <class AddCity>
+ParseStats parseCitiesText(const char* p, const char* end, AddCity addCity) {
+    ParseStats stats;
+    bool located = false;
+    while (p < end) {
+        std::string_view line = nextLine(p, end);
+        if (line.empty() || line == "Index Cityname") continue;
+        if (line == kLocatedCitiesHeader) {
+            located = true;
+            continue;
+        }
+        double lat = std::numeric_limits<double>::quiet_NaN(), lon = lat;
+        size_t space = line.find(' ');
+        if (space == std::string_view::npos || (located && !splitLocation(line, lat, lon)) || space + 1 >= line.size()) {
+            ++stats.skipped;
+            continue;
+        }
+        if (!addCity(line.substr(space + 1), lat, lon)) {
+            ++stats.skipped;
+            continue;
+        }
+        ++stats.parsed;
+    }
+    return stats;
+}
+
+// roads.txt: "Nbr Road Budget" header, then "<nbr>. <CityA>-<CityB> <budget>".
+// The city pair is resolved with splitCityPair(); addRoad(int a, int b,
+// double budget) gets each road.
+template <class Lookup, class AddRoad>
+ParseStats parseRoadsText(const char* p, const char* end, Lookup lookup, AddRoad addRoad) {
+    ParseStats stats;
+    while (p < end) {
+        std::string_view line = nextLine(p, end);
+        if (line.empty() || line == "Nbr Road Budget") continue;
+
+        size_t dot = line.find(". ");
+        size_t lastSpace = line.rfind(' ');
+        if (dot == std::string_view::npos || lastSpace == std::string_view::npos || lastSpace <= dot + 2) {
+            ++stats.skipped;
+            continue;
+        }
+        double budget = 0.0;
+        const char* numBegin = line.data() + lastSpace + 1;
+        const char* numEnd = line.data() + line.size();
+        if (std::from_chars(numBegin, numEnd, budget).ptr != numEnd) {
+            ++stats.skipped;
+            continue;
+        }
+
+        int a = -1, b = -1;
+        if (!splitCityPair(line.substr(dot + 2, lastSpace - dot - 2), lookup, a, b) || a == b) {
+            ++stats.skipped;
+            continue;
+        }
+        addRoad(a, b, budget);
+        ++stats.parsed;
+    }
+    return stats;
+}
+
+// Road inventory CSV: "<CityA>,<CityB>,<budget>" per line, the budget being
+// optional (0). Lines whose budget is not a number, such as a header, are
+// skipped like malformed ones.
+template <class Lookup, class AddRoad>
+ParseStats parseRoadsCsv(const char* p, const char* end, Lookup lookup, AddRoad addRoad) {
+    ParseStats stats;
+    while (p < end) {
+        std::string_view line = nextLine(p, end);
+        if (line.empty()) continue;
+
+        size_t comma = line.find(',');
+        size_t second = comma == std::string_view::npos ? comma : line.find(',', comma + 1);
+        double budget = 0.0;
+        if (second != std::string_view::npos) {
+            const char* numBegin = line.data() + second + 1;
+            const char* numEnd = line.data() + line.size();
+            if (std::from_chars(numBegin, numEnd, budget).ptr != numEnd) {
+                ++stats.skipped;
+                continue;
+            }
+        }
+        int a = comma == std::string_view::npos ? -1 : lookup(line.substr(0, comma));
+        int b = a == -1 ? -1 : lookup(line.substr(comma + 1, second == std::string_view::npos ? second : second - comma - 1));
+        if (b == -1 || a == b) {
+            ++stats.skipped;
+            continue;
+        }
+        addRoad(a, b, budget);
+        ++stats.parsed;
+    }
+    return stats;
+}
+
+// Write graph as roads.txt: the header, then "<nbr>. <A>-<B> <budget>" per
+// road, each road once, in (city, city) order
+template <class NameOf>
+void writeRoadsText(std::ostream& out, RoadGraph& graph, NameOf nameOf) {
+    out << "Nbr Road Budget\n"; // Header
+    int road_nbr = 1;
+    graph.compact(); // Roads come out in (city, city) order once compacted
+    graph.forEachRoad([&](uint32_t i, uint32_t j, double budget) { // Each road once
+        out << road_nbr++ << ". " << nameOf(i) << "-" << nameOf(j)
+            << " " << std::fixed << std::setprecision(2) << budget << "\n";
+    });
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint> // For fixed-width ids
+#include <utility> // For swap
+#include <vector>  // For parent and size arrays
+
+// Disjoint-set forest with path halving and union by size: any sequence of
+// m operations on n elements costs O(m * alpha(n)).
+class UnionFind {
+public:
+    explicit UnionFind(uint32_t n = 0) { reset(n); }
+
+    void reset(uint32_t n) {
+        parent_.resize(n);
+        size_.assign(n, 1);
+        for (uint32_t i = 0; i < n; ++i) parent_[i] = i;
+        sets_ = n;
+    }
+
+    // Add one singleton set and return its element
+    uint32_t add() {
+        parent_.push_back(uint32_t(parent_.size()));
+        size_.push_back(1);
+        ++sets_;
+        return parent_.back();
+    }
+
+    uint32_t find(uint32_t x) {
+        while (parent_[x] != x) {
+            parent_[x] = parent_[parent_[x]]; // Path halving
+            x = parent_[x];
+        }
+        return x;
+    }
+
+    // Returns false if a and b were already in the same set
+    bool unite(uint32_t a, uint32_t b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return false;
+        if (size_[a] < size_[b]) std::swap(a, b);
+        parent_[b] = a;
+        size_[a] += size_[b];
+        --sets_;
+        return true;
+    }
+
+    bool connected(uint32_t a, uint32_t b) { return find(a) == find(b); }
+    uint32_t setSize(uint32_t x) { return size_[find(x)]; }
+    uint32_t elementCount() const { return uint32_t(parent_.size()); }
+    uint32_t setCount() const { return sets_; }
+
+private:
+    std::vector<uint32_t> parent_;
+    std::vector<uint32_t> size_;
+    uint32_t sets_ = 0;
+};